@@ -0,0 +1,96 @@
+#include "../common/codec.h"
+#include "../common/protocol.h"
+#include "../udpserver/config.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+// dataset as generator leaves it, sorted descending for sorted delivery
+const std::vector<double>& dataset(bool sorted)
+{
+    static const auto make = [](bool sorted)
+    {
+        std::mt19937 engine(42);
+        std::uniform_real_distribution<double> spawn(-12414.41234523, 12414.41234523);
+        std::vector<double> values(GENERATOR_THRESHOLD);
+        for(auto& value : values)
+            value = spawn(engine);
+        if(sorted)
+            std::sort(values.begin(), values.end(), std::greater<>());
+        return values;
+    };
+    static const std::vector<double> random = make(false), ordered = make(true);
+    return sorted ? ordered : random;
+}
+
+void report(benchmark::State& state, std::size_t raw, std::size_t packed)
+{
+    state.counters["ratio"] = (double)raw / packed;
+    state.counters["bytes/s"] = benchmark::Counter(raw, benchmark::Counter::kIsRate);
+}
+
+} // namespace
+
+// one page after another, rates are of raw bytes
+static void BM_Compress(benchmark::State& state)
+{
+    auto codec = (Codec)state.range(0);
+    const auto& values = dataset(state.range(1));
+    const std::size_t count = (state.range(2) - sizeof(Header)) / sizeof(double);
+    std::vector<std::byte> out(compressBound(count));
+    std::size_t raw = 0, packed = 0, offset = 0;
+
+    for(auto _ : state)
+    {
+        packed += compress(values.data() + offset, count, codec, out.data());
+        raw += count * sizeof(double);
+        offset = offset + 2 * count <= values.size() ? offset + count : 0;
+        benchmark::DoNotOptimize(out.data());
+    }
+
+    report(state, raw, packed);
+}
+BENCHMARK(BM_Compress)->ArgNames({"codec", "sorted", "page"})
+    ->ArgsProduct({{(int)Codec::Shuffle, (int)Codec::XorShuffle}, {0, 1}, {PAGE_SIZE, GSO_PAGE_SIZE}});
+
+static void BM_Decompress(benchmark::State& state)
+{
+    auto codec = (Codec)state.range(0);
+    const auto& values = dataset(state.range(1));
+    const std::size_t count = (state.range(2) - sizeof(Header)) / sizeof(double);
+
+    // a handful of encoded pages in rotation
+    std::vector<std::vector<std::byte>> pages;
+    for(std::size_t offset = 0; pages.size() < 16; offset += count)
+    {
+        pages.emplace_back(compressBound(count));
+        pages.back().resize(compress(values.data() + offset, count, codec, pages.back().data()));
+    }
+
+    std::vector<double> out(count);
+    std::size_t raw = 0, packed = 0, next = 0;
+
+    for(auto _ : state)
+    {
+        const auto& page = pages[next++ % pages.size()];
+        if(!decompress(page.data(), page.size(), codec, out.data(), count))
+        {
+            state.SkipWithError("malformed page");
+            return;
+        }
+        raw += count * sizeof(double);
+        packed += page.size();
+        benchmark::DoNotOptimize(out.data());
+    }
+
+    report(state, raw, packed);
+}
+BENCHMARK(BM_Decompress)->ArgNames({"codec", "sorted", "page"})
+    ->ArgsProduct({{(int)Codec::Shuffle, (int)Codec::XorShuffle}, {0, 1}, {PAGE_SIZE, GSO_PAGE_SIZE}});
+
+BENCHMARK_MAIN();
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef UDP_BENCHMARKS_COMMON_H
+#define UDP_BENCHMARKS_COMMON_H
+
+#include "../udpserver/datastorage.h"
+#include <boost/asio/ip/udp.hpp>
+#include <atomic>
+#include <memory>
+#include <random>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+
+using boost::asio::ip::udp;
+
+// storage filled up to GENERATOR_THRESHOLD, the way a finished generator job leaves it
+inline std::shared_ptr<DataStorage> makeFilledStorage(double seed = 12414.41234523)
+{
+    auto storage = std::make_shared<DataStorage>();
+    std::mt19937 engine(42);
+    std::uniform_real_distribution<double> spawn(-seed, seed);
+
+    while(storage->size() < GENERATOR_THRESHOLD)
+        storage->insert(spawn(engine));
+
+    return storage;
+}
+
+// loopback socket on its own thread which drains and counts everything sent to it
+class LoopbackSink
+{
+    boost::asio::io_context     m_Context;
+    udp::socket                 m_Socket;
+    std::atomic<bool>           m_Stop = false;
+    std::atomic<uint64_t>       m_Received = 0;
+    std::jthread                m_Thread;
+
+    public:
+        LoopbackSink()
+            : m_Socket(m_Context, udp::endpoint(boost::asio::ip::address_v4::loopback(), 0))
+        {
+            m_Socket.set_option(boost::asio::socket_base::receive_buffer_size(8 << 20));
+            timeval timeout{0, 100'000};
+            setsockopt(m_Socket.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+            m_Thread = std::jthread([this]()
+            {
+                static char buffer[65536];
+                while(!m_Stop)
+                    if(::recv(m_Socket.native_handle(), buffer, sizeof(buffer), 0) > 0)
+                        ++m_Received;
+            });
+        }
+
+        ~LoopbackSink()
+        {
+            m_Stop = true;
+        }
+
+        udp::endpoint endpoint() const { return m_Socket.local_endpoint(); }
+        uint64_t received() const { return m_Received; }
+};
+
+#endif // UDP_BENCHMARKS_COMMON_H
\ No newline at end of file
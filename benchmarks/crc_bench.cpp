@@ -0,0 +1,38 @@
+#include "../common/crc32c.h"
+#include "../common/protocol.h"
+#include "../udpserver/config.h"
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+std::vector<double> page(std::size_t bytes)
+{
+    std::mt19937 engine(42);
+    std::uniform_real_distribution<double> spawn(-12414.41234523, 12414.41234523);
+    std::vector<double> values(bytes / sizeof(double));
+    for(auto& value : values)
+        value = spawn(engine);
+    return values;
+}
+
+} // namespace
+
+// checksum of one page payload as sent, kernel by runtime dispatch against portable one
+template<uint32_t(*Crc)(const void*, std::size_t, uint32_t)>
+static void BM_Crc32c(benchmark::State& state)
+{
+    auto values = page(state.range(0) - sizeof(Header));
+    const std::size_t bytes = values.size() * sizeof(double);
+
+    for(auto _ : state)
+        benchmark::DoNotOptimize(Crc(values.data(), bytes, 0));
+
+    state.counters["bytes/s"] = benchmark::Counter(state.iterations() * bytes, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Crc32c<crc32c>)->Name("BM_Crc32c")->ArgName("page")->Arg(PAGE_SIZE)->Arg(GSO_PAGE_SIZE);
+BENCHMARK(BM_Crc32c<crc32cPortable>)->Name("BM_Crc32cPortable")->ArgName("page")->Arg(PAGE_SIZE)->Arg(GSO_PAGE_SIZE);
+
+BENCHMARK_MAIN();
\ No newline at end of file
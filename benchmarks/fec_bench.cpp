@@ -0,0 +1,168 @@
+#include "../udpclient/udpclient.h"
+#include "../udpserver/config.h"
+#include "../udpserver/udpserver.h"
+#include <benchmark/benchmark.h>
+#include <boost/asio/ip/udp.hpp>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+
+using boost::asio::ip::udp;
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr uint16_t serverPort = 23456;
+constexpr double seed = 12414.41234523;
+
+/*
+ * Sits between client and server on loopback and drops datagrams going to the client
+ * with given probability, everything going to the server passes. Remembers when the
+ * request was forwarded, so time to the full dataset excludes the client start delay.
+*/
+class LossyRelay
+{
+    boost::asio::io_context     m_Context;
+    udp::socket                 m_Front;    // faces client
+    udp::socket                 m_Back;     // faces server
+    udp::endpoint               m_Server;
+    udp::endpoint               m_Client;
+    std::atomic<bool>           m_Stop = false;
+    std::atomic<bool>           m_Known = false;
+    std::atomic<uint64_t>       m_Requests = 0;
+    std::atomic<uint64_t>       m_Dropped = 0;
+    std::chrono::steady_clock::time_point   m_Start;
+    std::jthread                m_Upstream;
+    std::jthread                m_Downstream;
+
+    static void setup(udp::socket& socket)
+    {
+        socket.set_option(boost::asio::socket_base::receive_buffer_size(8 << 20));
+        timeval timeout{0, 100'000};
+        setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    public:
+        LossyRelay(uint16_t serverPort, double loss)
+            : m_Front(m_Context, udp::endpoint(boost::asio::ip::address_v6::loopback(), 0))
+            , m_Back(m_Context, udp::endpoint(boost::asio::ip::address_v6::loopback(), 0))
+            , m_Server(boost::asio::ip::address_v6::loopback(), serverPort)
+        {
+            setup(m_Front);
+            setup(m_Back);
+
+            m_Upstream = std::jthread([this]()
+            {
+                static char buffer[65536];
+                while(!m_Stop)
+                {
+                    // raw calls, asio waits for data forever once receive times out
+                    udp::endpoint sender;
+                    socklen_t length = sender.capacity();
+                    ssize_t recvd = ::recvfrom(m_Front.native_handle(), buffer, sizeof(buffer), 0, sender.data(), &length);
+                    if(recvd <= 0)
+                        continue;
+                    sender.resize(length);
+
+                    // first datagram is the request
+                    if(!m_Known.exchange(true))
+                    {
+                        m_Client = sender;
+                        m_Start = std::chrono::steady_clock::now();
+                    }
+                    else
+                        ++m_Requests;
+                    ::sendto(m_Back.native_handle(), buffer, recvd, 0, m_Server.data(), m_Server.size());
+                }
+            });
+
+            m_Downstream = std::jthread([this, loss]()
+            {
+                static char buffer[65536];
+                std::mt19937 engine(42);
+                std::bernoulli_distribution drop(loss);
+                while(!m_Stop)
+                {
+                    ssize_t recvd = ::recv(m_Back.native_handle(), buffer, sizeof(buffer), 0);
+                    if(recvd <= 0 || !m_Known)
+                        continue;
+
+                    if(drop(engine))
+                        ++m_Dropped;
+                    else
+                        ::sendto(m_Front.native_handle(), buffer, recvd, 0, m_Client.data(), m_Client.size());
+                }
+            });
+        }
+
+        ~LossyRelay()
+        {
+            m_Stop = true;
+        }
+
+        uint16_t port() const { return m_Front.local_endpoint().port(); }
+        std::chrono::steady_clock::time_point start() const { return m_Start; }
+        // client datagrams after the request: Nacks and Ack
+        uint64_t requests() const { return m_Requests; }
+        uint64_t dropped() const { return m_Dropped; }
+};
+
+uint64_t countRecovered(const fs::path& log)
+{
+    std::ifstream file(log);
+    uint64_t count = 0;
+    for(std::string line; std::getline(file, line);)
+        count += line.find("recovered") != std::string::npos;
+    return count;
+}
+
+} // namespace
+
+// time from the request to the whole dataset on the client, dropping given per mille of pages,
+// without FEC (lost pages are asked for again) and with one XOR parity page per group
+static void BM_LossyTransfer(benchmark::State& state)
+{
+    Settings settings;
+    settings.port = serverPort;
+    settings.fec = state.range(1);
+    settings.gso = state.range(2);
+    Server server(settings);
+
+    const fs::path output = fs::temp_directory_path() / "fec_bench.bin";
+    const fs::path log = output.string() + ".log";
+    uint64_t requests = 0, dropped = 0, recovered = 0;
+
+    for(auto _ : state)
+    {
+        fs::remove(log);
+        LossyRelay relay(serverPort, state.range(0) / 1000.);
+        {
+            // log is written out by the time client is gone
+            UDPClient client(seed, "::1", relay.port(), output.string());
+            client.waitUntilEnd();
+            state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - relay.start()).count());
+        }
+        requests += relay.requests();
+        dropped += relay.dropped();
+        recovered += countRecovered(log);
+    }
+
+    state.counters["dropped"] = benchmark::Counter(dropped, benchmark::Counter::kAvgIterations);
+    state.counters["recovered"] = benchmark::Counter(recovered, benchmark::Counter::kAvgIterations);
+    state.counters["requests"] = benchmark::Counter(requests, benchmark::Counter::kAvgIterations);
+    fs::remove(output);
+    fs::remove(log);
+}
+BENCHMARK(BM_LossyTransfer)->ArgNames({"loss", "fec", "gso"})
+    ->ArgsProduct({{0, 1, 10, 50}, {0, 8}, {0}})
+    ->ArgsProduct({{10, 50}, {0, 16}, {1}})
+    ->Iterations(3)->UseManualTime()->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "../udpserver/config.h"
+#include "../udpserver/generator.h"
+#include "../udpserver/storagepool.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+namespace
+{
+
+double processCpu()
+{
+    timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+} // namespace
+
+// CPU burnt by generator threads without any request, in percents of one core
+static void BM_IdleCpu(benchmark::State& state)
+{
+    StoragePool pool(1ull << 30);
+    Generator generator(state.range(0), pool);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10)); // threads reach their idle state
+
+    double cpu = 0;
+    for(auto _ : state)
+    {
+        double start = processCpu();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        cpu += processCpu() - start;
+    }
+
+    state.counters["idle_cpu_%"] = 100 * cpu / (state.iterations() * 0.1);
+}
+BENCHMARK(BM_IdleCpu)->ArgName("threads")->Arg(1)->Arg(4)->Iterations(5)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// single request to idle generator, time until some thread took it and started inserting
+static void BM_Wakeup(benchmark::State& state)
+{
+    StoragePool pool(1ull << 30, false, 1);
+    Generator generator(state.range(0), pool);
+    std::vector<double> latencies;
+    std::atomic<bool> done;
+
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2)); // every thread is parked again
+        done = false;
+        state.ResumeTiming();
+
+        auto start = std::chrono::steady_clock::now();
+        generator.addNewInstance(12414.41234523, [&](CStorage) { done = true; done.notify_one(); });
+        while(generator.waiting())
+            std::this_thread::sleep_for(std::chrono::microseconds(5)); // leaves the core to parked thread
+        latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+
+        done.wait(false);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies.empty() ? 0. : latencies[(latencies.size() - 1) * p]; };
+    state.counters["p50_us"] = percentile(0.5);
+    state.counters["p99_us"] = percentile(0.99);
+}
+BENCHMARK(BM_Wakeup)->ArgName("threads")->Arg(1)->Arg(4)->Iterations(100)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// one request at a time, filled by a single thread or split across all of them
+static void BM_SingleRequest(benchmark::State& state)
+{
+    StoragePool pool(1ull << 30, false, 1);
+    Generator generator(state.range(0), pool, state.range(1));
+    std::atomic<bool> done;
+
+    for(auto _ : state)
+    {
+        done = false;
+        generator.addNewInstance(12414.41234523, [&](CStorage) { done = true; done.notify_one(); });
+        done.wait(false);
+    }
+
+    state.counters["cores"] = std::thread::hardware_concurrency();
+}
+BENCHMARK(BM_SingleRequest)->ArgNames({"threads", "split"})
+    ->Args({1, 0})->Args({4, 0})->Args({4, 1})
+    ->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// sustained load: every thread count kept busy with 2 requests per thread in flight,
+// unique values per second of wall time
+static void BM_Throughput(benchmark::State& state)
+{
+    const uint32_t threads = state.range(0);
+    StoragePool pool(1ull << 31, false, 2 * threads);
+    Generator generator(threads, pool);
+    std::atomic<uint32_t> pending;
+    uint64_t datasets = 0;
+
+    for(auto _ : state)
+    {
+        pending = 2 * threads;
+        for(uint32_t i = 0; i < 2 * threads; ++i)
+            generator.addNewInstance(12414.41234523 + i, [&](CStorage) { if(--pending == 0) pending.notify_one(); });
+        for(uint32_t left = pending; left; left = pending)
+            pending.wait(left);
+        datasets += 2 * threads;
+    }
+
+    state.counters["uniques/s"] = benchmark::Counter(datasets * GENERATOR_THRESHOLD, benchmark::Counter::kIsRate);
+    state.counters["uniques/s/thread"] = benchmark::Counter(datasets * GENERATOR_THRESHOLD / threads, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Throughput)->ArgName("threads")->RangeMultiplier(2)->Range(1, 8)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// mixed bursts: waves of 1..burst requests arriving every 5 ms,
+// latency from request to finished dataset, which is when the first page may leave
+static void BM_TimeToFirstPage(benchmark::State& state)
+{
+    const uint32_t threads = state.range(0);
+    const uint32_t burst = state.range(1);
+    constexpr uint32_t waves = 4;
+
+    StoragePool pool(4ull << 30, false, threads);
+    Generator generator(threads, pool);
+    std::mt19937 engine(7);
+    std::uniform_int_distribution<uint32_t> size(1, burst);
+
+    std::mutex mutex;
+    std::vector<double> latencies;
+    std::atomic<uint32_t> pending = 0;
+
+    for(auto _ : state)
+    {
+        for(uint32_t wave = 0; wave < waves; ++wave)
+        {
+            for(uint32_t n = size(engine); n > 0; --n)
+            {
+                ++pending;
+                auto start = std::chrono::steady_clock::now();
+                bool accepted = generator.addNewInstance(12414.41234523, [&, start](CStorage)
+                {
+                    std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - start;
+                    {
+                        std::lock_guard _(mutex);
+                        latencies.push_back(latency.count());
+                    }
+                    --pending;
+                    pending.notify_one();
+                });
+
+                if(!accepted)
+                    --pending;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        while(uint32_t left = pending.load())
+            pending.wait(left);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies.empty() ? 0. : latencies[(latencies.size() - 1) * p]; };
+    state.counters["p50_ms"] = percentile(0.5);
+    state.counters["p99_ms"] = percentile(0.99);
+    state.counters["max_ms"] = latencies.empty() ? 0. : latencies.back();
+    state.counters["requests"] = latencies.size();
+}
+BENCHMARK(BM_TimeToFirstPage)->ArgNames({"threads", "burst"})
+    ->Args({1, 8})->Args({2, 8})->Args({4, 4})
+    ->Iterations(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,126 @@
+#include "common.h"
+#include "../udpserver/handoff.h"
+#include "../udpserver/sessiontable.h"
+#include "../udpserver/submitinfo.h"
+#include <algorithm>
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t numOfProducers = 2;
+constexpr uint32_t numOfClients = 512;
+constexpr std::chrono::microseconds completionPeriod{50};
+
+udp::endpoint client(uint32_t i)
+{
+    return udp::endpoint(boost::asio::ip::address_v4::loopback(), 20000 + i % numOfClients);
+}
+
+} // namespace
+
+/*
+ * Latency of NACK handling (datagram in, session lookup) on the network thread
+ * while generator threads keep completing datasets, either
+ * directly (SubmitInfo + session insert on generator thread, then post to io_context)
+ * or through Handoff (ring push + eventfd, network thread does the rest).
+*/
+static void BM_NackLatency(benchmark::State& state)
+{
+    const bool handoffMode = state.range(0);
+    static auto storage = makeFilledStorage();
+
+    boost::asio::io_context context;
+    auto guard = boost::asio::make_work_guard(context);
+    udp::socket socket(context, udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    SessionTable sessions;
+    Handoff<uint32_t> handoff(context);
+
+    for(uint32_t i = 0; i < numOfClients; ++i)
+        sessions.insert(std::make_shared<SubmitInfo>(storage->getUnderlying(), std::make_shared<udp::endpoint>(client(i))));
+
+    handoff.start([&](uint32_t i)
+    {
+        sessions.insert(std::make_shared<SubmitInfo>(storage->getUnderlying(), std::make_shared<udp::endpoint>(client(i))));
+    });
+
+    std::vector<double> latencies;
+    std::atomic<uint64_t> handled = 0;
+    Clock::rep stamp;
+    udp::endpoint sender;
+
+    std::function<void()> receive = [&]()
+    {
+        socket.async_receive_from(boost::asio::buffer(&stamp, sizeof(stamp)), sender,
+            [&](const boost::system::error_code& error, std::size_t)
+            {
+                if(error)
+                    return;
+                benchmark::DoNotOptimize(sessions.find(client(stamp)));
+                latencies.push_back(std::chrono::duration<double, std::micro>(
+                    Clock::now().time_since_epoch() - Clock::duration(stamp)).count());
+                handled.fetch_add(1, std::memory_order_release);
+                receive();
+            });
+    };
+    receive();
+
+    std::jthread network([&]() { context.run(); });
+
+    std::vector<std::jthread> producers;
+    for(uint32_t p = 0; p < numOfProducers; ++p)
+    {
+        producers.emplace_back([&, p](std::stop_token stop)
+        {
+            for(uint32_t i = p; !stop.stop_requested(); i += numOfProducers)
+            {
+                if(handoffMode)
+                {
+                    handoff.push(i);
+                }
+                else
+                {
+                    auto info = std::make_shared<SubmitInfo>(storage->getUnderlying(), std::make_shared<udp::endpoint>(client(i)));
+                    sessions.insert(info);
+                    boost::asio::post(context, [info]() { benchmark::DoNotOptimize(info->pages().size()); });
+                }
+                std::this_thread::sleep_for(completionPeriod);
+            }
+        });
+    }
+
+    boost::asio::io_context probeContext;
+    udp::socket probe(probeContext, udp::endpoint(udp::v4(), 0));
+
+    for(auto _ : state)
+    {
+        uint64_t before = handled.load(std::memory_order_acquire);
+        Clock::rep now = Clock::now().time_since_epoch().count();
+        probe.send_to(boost::asio::buffer(&now, sizeof(now)), socket.local_endpoint());
+        while(handled.load(std::memory_order_acquire) == before)
+            std::this_thread::yield();
+    }
+
+    producers.clear();
+    guard.reset();
+    context.stop();
+    network.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies.empty() ? 0. : latencies[(latencies.size() - 1) * p]; };
+    state.counters["p50_us"] = percentile(0.5);
+    state.counters["p99_us"] = percentile(0.99);
+    state.counters["p999_us"] = percentile(0.999);
+}
+BENCHMARK(BM_NackLatency)->ArgName("handoff")->Arg(0)->Arg(1)->Iterations(20000)->UseRealTime();
+
+BENCHMARK_MAIN();
\ No newline at end of file
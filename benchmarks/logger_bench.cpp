@@ -0,0 +1,72 @@
+#include "../common/logger.h"
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+// the logger as it was: ofstream flushed on every line, caller pays for the write
+class SyncLogger : public Logger
+{
+    std::ofstream   m_Logfile;
+
+    protected:
+        void write(std::string_view message) override
+        {
+            m_Logfile << now() << " | " << message << std::endl;
+        }
+
+    public:
+        SyncLogger(const std::string& name)
+            : m_Logfile(name, std::ios::app)
+        {
+
+        }
+};
+
+const fs::path path = fs::temp_directory_path() / "logger_bench.log";
+
+} // namespace
+
+// every completion handler logs its error code
+static void BM_LogNoError(benchmark::State& state)
+{
+    FileLogger log(path.string());
+    boost::system::error_code error;
+    for(auto _ : state)
+        benchmark::DoNotOptimize(log.log(error));
+}
+BENCHMARK(BM_LogNoError);
+
+// filtered out by level
+static void BM_LogFiltered(benchmark::State& state)
+{
+    FileLogger log(path.string(), Level::Warning);
+    for(auto _ : state)
+        log.log("page 42 recovered");
+}
+BENCHMARK(BM_LogFiltered);
+
+// cost seen by the logging thread
+template<typename Log>
+static void BM_LogLine(benchmark::State& state)
+{
+    Log log(path.string());
+    for(auto _ : state)
+        log.log("page 42 recovered");
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_LogLine, FileLogger)->Threads(1)->Threads(2);
+BENCHMARK_TEMPLATE(BM_LogLine, SyncLogger)->Threads(1);
+
+static void BM_Cleanup(benchmark::State& state)
+{
+    for(auto _ : state)
+        fs::remove(path);
+}
+BENCHMARK(BM_Cleanup)->Iterations(1);
+
+BENCHMARK_MAIN();
\ No newline at end of file
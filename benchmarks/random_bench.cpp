@@ -0,0 +1,97 @@
+#include "../udpserver/bulkrandom.h"
+#include "../udpserver/config.h"
+#include "../udpserver/datastorage.h"
+#include <benchmark/benchmark.h>
+#include <array>
+#include <memory>
+#include <random>
+
+namespace
+{
+
+constexpr double seed = 12414.41234523;
+
+void report(benchmark::State& state, uint64_t unique)
+{
+    state.counters["ns/unique"] = benchmark::Counter(unique, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["unique/s"] = benchmark::Counter(unique, benchmark::Counter::kIsRate);
+}
+
+} // namespace
+
+// previous generation path: one value at a time from mt19937 through uniform_real_distribution
+static void BM_Mt19937(benchmark::State& state)
+{
+    std::mt19937 engine(42);
+    std::uniform_real_distribution<double> spawn(-seed, seed);
+    uint64_t unique = 0;
+
+    for(auto _ : state)
+    {
+        auto storage = std::make_unique<DataStorage>();
+        while(storage->size() < GENERATOR_THRESHOLD)
+            storage->insert(spawn(engine));
+        unique += storage->size();
+    }
+
+    report(state, unique);
+}
+BENCHMARK(BM_Mt19937)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Philox blocks of GENERATION_BATCH fed to storage, as generator job does, per kernel
+static void BM_BulkRandom(benchmark::State& state)
+{
+    auto level = (SimdLevel)state.range(0);
+    if(level > detectSimd())
+    {
+        state.SkipWithError("kernel not supported by this CPU");
+        return;
+    }
+
+    BulkRandom spawn(-seed, seed, 42, level);
+    std::array<double, GENERATION_BATCH> batch;
+    uint64_t unique = 0;
+
+    for(auto _ : state)
+    {
+        auto storage = std::make_unique<DataStorage>();
+        while(storage->size() < GENERATOR_THRESHOLD)
+        {
+            spawn.fill(batch.data(), batch.size());
+            storage->insertBatch(batch);
+        }
+        unique += storage->size();
+    }
+
+    report(state, unique);
+}
+BENCHMARK(BM_BulkRandom)->ArgName("simd")
+    ->Arg((int)SimdLevel::Scalar)->Arg((int)SimdLevel::Avx2)->Arg((int)SimdLevel::Avx512)
+    ->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// raw kernel throughput, without storage
+static void BM_BulkFill(benchmark::State& state)
+{
+    auto level = (SimdLevel)state.range(0);
+    if(level > detectSimd())
+    {
+        state.SkipWithError("kernel not supported by this CPU");
+        return;
+    }
+
+    BulkRandom spawn(-seed, seed, 42, level);
+    std::array<double, GENERATION_BATCH> batch;
+
+    for(auto _ : state)
+    {
+        spawn.fill(batch.data(), batch.size());
+        benchmark::DoNotOptimize(batch.data());
+    }
+
+    state.counters["ns/double"] = benchmark::Counter(state.iterations() * batch.size(),
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_BulkFill)->ArgName("simd")
+    ->Arg((int)SimdLevel::Scalar)->Arg((int)SimdLevel::Avx2)->Arg((int)SimdLevel::Avx512);
+
+BENCHMARK_MAIN();
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "common.h"
+#include "../udpserver/sessiontable.h"
+#include "../udpserver/submitinfo.h"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+udp::endpoint client(uint32_t i)
+{
+    // spread clients over addresses and ports like a real fleet
+    return udp::endpoint(boost::asio::ip::make_address_v6(boost::asio::ip::v4_mapped,
+        boost::asio::ip::address_v4(0x0a000000 + i / 64)), 40000 + i % 64);
+}
+
+std::vector<std::shared_ptr<SubmitInfo>> makeSessions(uint32_t count)
+{
+    static auto storage = makeFilledStorage();
+
+    std::vector<std::shared_ptr<SubmitInfo>> sessions;
+    for(uint32_t i = 0; i < count; ++i)
+        sessions.push_back(std::make_shared<SubmitInfo>(storage->getUnderlying(), std::make_shared<udp::endpoint>(client(i))));
+    return sessions;
+}
+
+} // namespace
+
+// previous submit queue: vector scanned by find_if (compared by endpoint value here)
+static void BM_LinearScanFind(benchmark::State& state)
+{
+    auto sessions = makeSessions(state.range(0));
+    std::mt19937 engine(state.thread_index());
+    std::uniform_int_distribution<uint32_t> pick(0, sessions.size() - 1);
+
+    for(auto _ : state)
+    {
+        auto endpoint = client(pick(engine));
+        auto iter = std::find_if(sessions.begin(), sessions.end(), [&](const auto& val) { return *val->dst() == endpoint; });
+        benchmark::DoNotOptimize(iter);
+    }
+}
+BENCHMARK(BM_LinearScanFind)->RangeMultiplier(4)->Range(1024, 16384);
+
+static void BM_SessionTableFind(benchmark::State& state)
+{
+    static SessionTable table(1 << 20);
+
+    if(state.thread_index() == 0)
+        for(auto& session : makeSessions(state.range(0)))
+            table.insert(std::move(session));
+
+    std::mt19937 engine(state.thread_index());
+    std::uniform_int_distribution<uint32_t> pick(0, state.range(0) - 1);
+
+    for(auto _ : state)
+        benchmark::DoNotOptimize(table.find(client(pick(engine))));
+
+    if(state.thread_index() == 0)
+        table.expire(std::chrono::steady_clock::duration::zero());
+}
+BENCHMARK(BM_SessionTableFind)->RangeMultiplier(4)->Range(1024, 16384)->ThreadRange(1, 4);
+
+// accept, lookup and confirm cycle with the table kept at given size
+static void BM_SessionTableChurn(benchmark::State& state)
+{
+    SessionTable table(1 << 20);
+    auto sessions = makeSessions(state.range(0) * 2);
+
+    for(uint32_t i = 0; i < state.range(0); ++i)
+        table.insert(sessions[i]);
+
+    uint32_t next = state.range(0);
+    for(auto _ : state)
+    {
+        const auto& session = sessions[next % sessions.size()];
+        table.insert(session);
+        benchmark::DoNotOptimize(table.find(*session->dst()));
+        table.erase(*sessions[(next - state.range(0)) % sessions.size()]->dst());
+        ++next;
+    }
+
+    state.counters["sessions"] = table.size();
+}
+BENCHMARK(BM_SessionTableChurn)->RangeMultiplier(4)->Range(1024, 16384);
+
+BENCHMARK_MAIN();
\ No newline at end of file
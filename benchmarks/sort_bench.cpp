@@ -0,0 +1,164 @@
+#include "common.h"
+#include "../common/merge.h"
+#include "../common/radixsort.h"
+#include "../udpclient/mappedfile.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace
+{
+
+const std::vector<double>& dataset()
+{
+    static const std::vector<double> values = []()
+    {
+        auto storage = makeFilledStorage();
+        return std::vector<double>(storage->data(), storage->data() + storage->size());
+    }();
+    return values;
+}
+
+// dataset cut into pages as they arrive at client, sorted when sortPages
+std::vector<std::vector<double>> pages(bool sortPages)
+{
+    constexpr std::size_t perPage = PAGE_SIZE / sizeof(double);
+    std::vector<std::vector<double>> result;
+    auto& values = dataset();
+    for(std::size_t i = 0; i < values.size(); i += perPage)
+    {
+        result.emplace_back(values.begin() + i, values.begin() + std::min(i + perPage, values.size()));
+        if(sortPages)
+            std::sort(result.back().begin(), result.back().end(), std::greater<>());
+    }
+    return result;
+}
+
+} // namespace
+
+// what client does after the last page arrived
+static void BM_StdSort(benchmark::State& state)
+{
+    std::vector<double> values;
+
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        values = dataset();
+        state.ResumeTiming();
+
+        if(state.range(0))
+            std::sort(std::execution::par_unseq, values.begin(), values.end(), std::greater<>());
+        else
+            std::sort(values.begin(), values.end(), std::greater<>());
+    }
+
+    state.counters["ns/value"] = benchmark::Counter(state.iterations() * values.size(),
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_StdSort)->ArgName("par_unseq")->Arg(0)->Arg(1)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// what server does in sorted mode, scratch is the hash table there
+static void BM_RadixSort(benchmark::State& state)
+{
+    std::vector<double> values;
+    std::vector<double> scratch(GENERATOR_THRESHOLD);
+
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        values = dataset();
+        state.ResumeTiming();
+
+        radixSortDescending(values, scratch, state.range(0));
+    }
+
+    if(!std::is_sorted(values.begin(), values.end(), std::greater<>()))
+        state.SkipWithError("not sorted");
+
+    state.counters["ns/value"] = benchmark::Counter(state.iterations() * values.size(),
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_RadixSort)->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// client work per arriving page, overlapped with receiving
+static void BM_PageSort(benchmark::State& state)
+{
+    auto unsorted = pages(false);
+    std::vector<std::vector<double>> sorting;
+    std::vector<double> scratch(PAGE_SIZE / sizeof(double));
+
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        sorting = unsorted;
+        state.ResumeTiming();
+
+        for(auto& page : sorting)
+            radixSortDescending(page, scratch);
+    }
+
+    state.counters["ns/value"] = benchmark::Counter(state.iterations() * dataset().size(),
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_PageSort)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// client work left after the last page arrived
+static void BM_MergePages(benchmark::State& state)
+{
+    auto sorted = pages(true);
+    std::vector<std::span<const double>> runs(sorted.begin(), sorted.end());
+    std::vector<double> out(dataset().size());
+
+    for(auto _ : state)
+    {
+        mergeDescending(runs, out, state.range(0));
+        benchmark::DoNotOptimize(out.data());
+    }
+
+    if(!std::is_sorted(out.begin(), out.end(), std::greater<>()))
+        state.SkipWithError("not sorted");
+
+    state.counters["ns/value"] = benchmark::Counter(state.iterations() * out.size(),
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_MergePages)->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// client work after the last page including output file: merge to vector and ofstream write before,
+// merge straight to mapped file now
+static void BM_MergeToFile(benchmark::State& state)
+{
+    auto sorted = pages(true);
+    std::vector<std::span<const double>> runs(sorted.begin(), sorted.end());
+    const std::size_t total = dataset().size();
+    const std::string path = (std::filesystem::temp_directory_path() / "sort_bench.bin").string();
+
+    for(auto _ : state)
+    {
+        if(state.range(0))
+        {
+            MappedFile file;
+            file.create(path, total);
+            mergeDescending(runs, file.data());
+            file.close(total);
+        }
+        else
+        {
+            std::vector<double> out(total);
+            mergeDescending(runs, out);
+            std::ofstream(path, std::ios::out | std::ios::binary).write((char*)out.data(), sizeof(double) * out.size());
+        }
+    }
+
+    std::filesystem::remove(path);
+    state.counters["ns/value"] = benchmark::Counter(state.iterations() * total,
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_MergeToFile)->ArgName("mapped")->Arg(0)->Arg(1)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
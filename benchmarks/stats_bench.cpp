@@ -0,0 +1,37 @@
+#include "../udpserver/stats.h"
+#include <benchmark/benchmark.h>
+#include <chrono>
+
+namespace
+{
+
+Stats stats;
+
+} // namespace
+
+// counter bump on the hot path, threads record into own slots
+static void BM_StatsAdd(benchmark::State& state)
+{
+    for(auto _ : state)
+        stats.add(Counter::PagesSent);
+}
+BENCHMARK(BM_StatsAdd)->ThreadRange(1, 4);
+
+// latency sample, clock read included
+static void BM_StatsRecord(benchmark::State& state)
+{
+    auto accepted = std::chrono::steady_clock::now();
+    for(auto _ : state)
+        stats.record(Stage::FirstPage, accepted);
+}
+BENCHMARK(BM_StatsRecord)->ThreadRange(1, 4);
+
+// what a Stats query costs the network thread
+static void BM_StatsJson(benchmark::State& state)
+{
+    for(auto _ : state)
+        benchmark::DoNotOptimize(stats.json({{"waiting", 0}}));
+}
+BENCHMARK(BM_StatsJson);
+
+BENCHMARK_MAIN();
\ No newline at end of file
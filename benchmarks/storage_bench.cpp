@@ -0,0 +1,164 @@
+#include "../udpserver/bulkrandom.h"
+#include "../udpserver/config.h"
+#include "../udpserver/datastorage.h"
+#include "../udpserver/storagepool.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <vector>
+
+namespace
+{
+
+constexpr uint32_t groupSize = 16; // slots DataStorage probes at once
+
+// a bit more than threshold, duplicates are possible in theory
+const std::vector<double>& values()
+{
+    static const std::vector<double> instance = []()
+    {
+        std::vector<double> values(GENERATOR_THRESHOLD + GENERATION_BATCH);
+        BulkRandom(-12414.41234523, 12414.41234523, 42).fill(values.data(), values.size());
+        return values;
+    }();
+    return instance;
+}
+
+} // namespace
+
+// one probe per value
+static void BM_Insert(benchmark::State& state)
+{
+    uint64_t unique = 0;
+
+    for(auto _ : state)
+    {
+        auto storage = std::make_unique<DataStorage>();
+        for(double value : values())
+            storage->insert(value);
+        unique += storage->size();
+    }
+
+    state.counters["ns/insert"] = benchmark::Counter(unique, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_Insert)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// blocks of given size, as generator job feeds them
+static void BM_InsertBatch(benchmark::State& state)
+{
+    const std::size_t block = state.range(0);
+    uint64_t unique = 0;
+
+    for(auto _ : state)
+    {
+        auto storage = std::make_unique<DataStorage>();
+        std::span<const double> all(values());
+        for(std::size_t i = 0; i < all.size(); i += block)
+            storage->insertBatch(all.subspan(i, std::min(block, all.size() - i)));
+        unique += storage->size();
+    }
+
+    state.counters["ns/insert"] = benchmark::Counter(unique, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_InsertBatch)->ArgName("block")->Arg(GENERATION_BATCH)->Arg(4096)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// cost of the last quarter of values inserted up to given percentage of the threshold,
+// as the table fills up probe sequences grow
+static void BM_InsertLoad(benchmark::State& state)
+{
+    std::span<const double> all(values());
+    const std::size_t from = GENERATOR_THRESHOLD * (state.range(0) - 25) / 100;
+    const std::size_t to = GENERATOR_THRESHOLD * state.range(0) / 100;
+    uint64_t unique = 0;
+    double load = 0;
+
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        auto storage = std::make_unique<DataStorage>();
+        storage->insertBatch(all.first(from));
+        state.ResumeTiming();
+
+        for(std::size_t i = from; i < to; i += GENERATION_BATCH)
+            unique += storage->insertBatch(all.subspan(i, std::min<std::size_t>(GENERATION_BATCH, to - i)));
+        load = double(storage->size()) / storage->control().size();
+    }
+
+    state.counters["load"] = load;
+    state.counters["ns/insert"] = benchmark::Counter(unique, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_InsertLoad)->ArgName("fill%")->DenseRange(25, 100, 25)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// distribution of probe sequence lengths (groups visited) of a value hashed to each group of storage
+// filled up to given percentage of the threshold: linear probing walks past every full group, so it's
+// 1 + run of full groups from there, read off the control bytes. Timed part looks every value up again
+// by inserting it once more, the way generator meets duplicates (full storage takes no more inserts, hence 95%)
+static void BM_ProbeLength(benchmark::State& state)
+{
+    std::span<const double> all = std::span<const double>(values()).first(GENERATOR_THRESHOLD * state.range(0) / 100);
+    auto storage = std::make_unique<DataStorage>();
+    storage->insertBatch(all);
+
+    auto control = storage->control();
+    const std::size_t groups = control.size() / groupSize;
+    auto full = [&](std::size_t group)
+    {
+        auto slots = control.subspan(group % groups * groupSize, groupSize);
+        return std::none_of(slots.begin(), slots.end(), [](uint8_t byte) { return byte & 0x80; });
+    };
+
+    // walked backwards, so every group extends the run of the one after it
+    std::vector<uint32_t> lengths(groups);
+    uint32_t run = 0;
+    for(std::size_t g = 2 * groups; g-- > 0;)
+    {
+        run = full(g) ? run + 1 : 0;
+        if(g < groups)
+            lengths[g] = run + 1;
+    }
+    std::sort(lengths.begin(), lengths.end());
+
+    for(auto _ : state)
+    {
+        uint32_t inserted = 0;
+        for(std::size_t i = 0; i < all.size(); i += GENERATION_BATCH)
+            inserted += storage->insertBatch(all.subspan(i, std::min<std::size_t>(GENERATION_BATCH, all.size() - i)));
+        benchmark::DoNotOptimize(inserted);
+    }
+
+    auto percentile = [&](double p) { return lengths[(lengths.size() - 1) * p]; };
+    state.counters["load"] = double(storage->size()) / control.size();
+    state.counters["mean"] = std::accumulate(lengths.begin(), lengths.end(), 0.) / lengths.size();
+    state.counters["p99"] = percentile(0.99);
+    state.counters["max"] = lengths.back();
+    state.counters["over1"] = double(lengths.end() - std::upper_bound(lengths.begin(), lengths.end(), 1u)) / lengths.size();
+    state.counters["ns/lookup"] = benchmark::Counter(state.iterations() * all.size(), benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_ProbeLength)->ArgName("fill%")->Arg(25)->Arg(50)->Arg(75)->Arg(95)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// whole dataset life: get empty storage, fill it, drop it, from fresh allocation or pool
+static void BM_Lifecycle(benchmark::State& state)
+{
+    const bool pooled = state.range(0);
+    StoragePool pool(1ull << 30, false, 1);
+    std::span<const double> all(values());
+
+    for(auto _ : state)
+    {
+        auto storage = pooled ? pool.acquire() : std::make_shared<DataStorage>();
+        for(std::size_t i = 0; i < all.size(); i += GENERATION_BATCH)
+            storage->insertBatch(all.subspan(i, std::min<std::size_t>(GENERATION_BATCH, all.size() - i)));
+
+        CStorage values = storage->getUnderlying();
+        storage.reset();
+        benchmark::DoNotOptimize(values->data());
+    }
+
+    state.counters["datasets/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+    state.counters["MiB mapped"] = pool.mapped() >> 20;
+}
+BENCHMARK(BM_Lifecycle)->ArgName("pooled")->Arg(0)->Arg(1)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
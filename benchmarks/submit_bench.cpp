@@ -0,0 +1,29 @@
+#include "common.h"
+#include "../udpserver/config.h"
+#include "../udpserver/submitinfo.h"
+#include <benchmark/benchmark.h>
+#include <memory>
+
+// building what the transmitter sends for a finished dataset: headers of every page,
+// parity pages when FEC is on and CRC32C of every datagram, before any byte leaves
+static void BM_SubmitInfo(benchmark::State& state)
+{
+    CStorage storage = makeFilledStorage()->getUnderlying();
+    auto destination = std::make_shared<udp::endpoint>(boost::asio::ip::address_v4::loopback(), 12345);
+    uint32_t datagrams = 0;
+
+    for(auto _ : state)
+    {
+        SubmitInfo info(storage, destination, state.range(0), state.range(1));
+        datagrams = info.datagrams();
+        benchmark::DoNotOptimize(info.header(0).data());
+    }
+
+    state.counters["datagrams"] = datagrams;
+    state.counters["bytes/s"] = benchmark::Counter(state.iterations() * sizeof(double) * GENERATOR_THRESHOLD, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SubmitInfo)->ArgNames({"page", "fec"})
+    ->ArgsProduct({{PAGE_SIZE, GSO_PAGE_SIZE}, {0, 8}})
+    ->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
\ No newline at end of file
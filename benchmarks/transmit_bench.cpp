@@ -0,0 +1,120 @@
+#include "common.h"
+#include "../udpserver/submitinfo.h"
+#include "../udpserver/transmitter.h"
+#include <benchmark/benchmark.h>
+#include <boost/asio/io_context.hpp>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <thread>
+
+namespace
+{
+
+struct Dataset
+{
+    std::shared_ptr<DataStorage>   storage = makeFilledStorage();
+    SubmitInfo                     info{storage->getUnderlying(), std::make_shared<udp::endpoint>()};
+    SubmitInfo                     small{storage->getUnderlying(), std::make_shared<udp::endpoint>(), GSO_PAGE_SIZE};
+};
+
+const Dataset& dataset()
+{
+    static Dataset instance;
+    return instance;
+}
+
+} // namespace
+
+// previous send path: one send_to per page, optionally with the 1 ms sleep before every page
+static void BM_PagePerSyscall(benchmark::State& state)
+{
+    const auto& pages = dataset().info.pages();
+    const bool paced = state.range(0);
+
+    LoopbackSink sink;
+    boost::asio::io_context context;
+    udp::socket socket(context, udp::endpoint(udp::v4(), 0));
+
+    for(auto _ : state)
+    {
+        for(const auto& page : pages)
+        {
+            if(paced)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            socket.send_to(page, sink.endpoint());
+        }
+    }
+
+    state.counters["pages/s"] = benchmark::Counter(state.iterations() * pages.size(), benchmark::Counter::kIsRate);
+    state.counters["syscalls/dataset"] = pages.size();
+    state.counters["delivered"] = sink.received() / double(state.iterations() * pages.size());
+}
+BENCHMARK(BM_PagePerSyscall)->ArgName("paced")->Arg(0)->Arg(1)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// batched send path: whole dataset queued into Transmitter, flushed by sendmmsg,
+// paced by default token buckets or unpaced (infinite rate)
+static void BM_Sendmmsg(benchmark::State& state)
+{
+    const auto& info = dataset().info;
+    const auto& pages = info.pages();
+
+    Pacing pacing;
+    if(!state.range(0))
+        pacing.flowRate = pacing.globalRate = std::numeric_limits<double>::infinity();
+
+    LoopbackSink sink;
+    boost::asio::io_context context;
+    udp::socket socket(context, udp::endpoint(udp::v4(), 0));
+    Transmitter transmitter(socket, std::make_shared<CoutLogger>(), pacing);
+
+    for(auto _ : state)
+    {
+        for(uint32_t i = 0; i < pages.size(); ++i)
+            transmitter.send(sink.endpoint(), info.header(i), pages[i], nullptr);
+
+        context.restart();
+        context.run();
+    }
+
+    state.counters["pages/s"] = benchmark::Counter(transmitter.sent(), benchmark::Counter::kIsRate);
+    state.counters["syscalls/dataset"] = transmitter.syscalls() / double(state.iterations());
+    state.counters["delivered"] = sink.received() / double(state.iterations() * pages.size());
+}
+BENCHMARK(BM_Sendmmsg)->ArgName("paced")->Arg(0)->Arg(1)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// frame-size pages, sent one per message or glued into UDP_SEGMENT runs, headers gathered from their own buffer
+static void BM_Segmentation(benchmark::State& state)
+{
+    const auto& info = dataset().small;
+    const auto& pages = info.pages();
+
+    Pacing pacing;
+    pacing.flowRate = pacing.globalRate = std::numeric_limits<double>::infinity();
+
+    LoopbackSink sink;
+    boost::asio::io_context context;
+    udp::socket socket(context, udp::endpoint(udp::v4(), 0));
+    Transmitter transmitter(socket, std::make_shared<CoutLogger>(), pacing, state.range(0));
+
+    for(auto _ : state)
+    {
+        for(uint32_t i = 0; i < pages.size(); ++i)
+            transmitter.send(sink.endpoint(), info.header(i), pages[i], nullptr);
+
+        context.restart();
+        context.run();
+    }
+
+    if(state.range(0) && !transmitter.segmentation())
+        state.SkipWithError("UDP_SEGMENT not supported");
+
+    state.counters["pages/s"] = benchmark::Counter(transmitter.sent(), benchmark::Counter::kIsRate);
+    state.counters["bytes/s"] = benchmark::Counter(state.iterations() * dataset().storage->size() * sizeof(double),
+        benchmark::Counter::kIsRate, benchmark::Counter::kIs1024);
+    state.counters["syscalls/dataset"] = transmitter.syscalls() / double(state.iterations());
+    state.counters["delivered"] = sink.received() / double(state.iterations() * pages.size());
+}
+BENCHMARK(BM_Segmentation)->ArgName("gso")->Arg(0)->Arg(1)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,296 @@
+#include "codec.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <emmintrin.h>
+#include <vector>
+
+namespace
+{
+
+enum class Plane : uint8_t
+{
+    Raw,        // bytes as they are
+    Sparse,     // base, uint16 count, uint16 positions, bytes
+    Mask,       // base, bitmap of positions, bytes
+};
+
+// rotated, so exponent fills the top byte and sign goes to the lowest one, which is random anyway
+void transform(const double* values, std::size_t count, Codec codec, uint64_t* words)
+{
+    memcpy(words, values, count * sizeof(double));
+    if(codec == Codec::XorShuffle)
+        for(std::size_t i = count; i-- > 1;)
+            words[i] ^= words[i - 1];
+    for(std::size_t i = 0; i < count; ++i)
+        words[i] = std::rotl(words[i], 1);
+}
+
+void restore(uint64_t* words, std::size_t count, Codec codec, double* values)
+{
+    for(std::size_t i = 0; i < count; ++i)
+        words[i] = std::rotr(words[i], 1);
+    if(codec == Codec::XorShuffle)
+        for(std::size_t i = 1; i < count; ++i)
+            words[i] ^= words[i - 1];
+    memcpy(values, words, count * sizeof(double));
+}
+
+// byte interleave of vectors whose index differs in given bit: every round moves the top bit
+// of byte position to the vector index and that index bit to the bottom of byte position
+void interleave(__m128i* v, int bit)
+{
+    __m128i r[8];
+    for(int k = 0; k < 8; ++k)
+        if(!(k & bit))
+        {
+            r[k] = _mm_unpacklo_epi8(v[k], v[k | bit]);
+            r[k | bit] = _mm_unpackhi_epi8(v[k], v[k | bit]);
+        }
+    std::copy(r, r + 8, v);
+}
+
+// plane b gets byte b of every word, 16 words per 8x16 byte transpose
+void shuffle(const uint64_t* words, std::size_t count, uint8_t* planes)
+{
+    std::size_t i = 0;
+    for(; i + 16 <= count; i += 16)
+    {
+        __m128i v[8];
+        for(int k = 0; k < 8; ++k)
+            v[k] = _mm_loadu_si128((const __m128i*)(words + i + 2 * k));
+        interleave(v, 4);
+        interleave(v, 2);
+        interleave(v, 1);
+        interleave(v, 4);
+        for(int b = 0; b < 8; ++b)
+            _mm_storeu_si128((__m128i*)(planes + b * count + i), v[(b & 1) * 4 + (b >> 2) * 2 + (b >> 1 & 1)]);
+    }
+
+    for(; i < count; ++i)
+        for(int b = 0; b < 8; ++b)
+            planes[b * count + i] = words[i] >> 8 * b;
+}
+
+void unshuffle(const uint8_t* planes, std::size_t count, uint64_t* words)
+{
+    std::size_t i = 0;
+    for(; i + 16 <= count; i += 16)
+    {
+        __m128i v[8];
+        for(int b = 0; b < 8; ++b)
+            v[b] = _mm_loadu_si128((const __m128i*)(planes + b * count + i));
+        interleave(v, 4);
+        interleave(v, 2);
+        interleave(v, 1);
+        for(int k = 0; k < 8; ++k)
+            _mm_storeu_si128((__m128i*)(words + i + 2 * k), v[k]);
+    }
+
+    for(; i < count; ++i)
+    {
+        words[i] = 0;
+        for(int b = 0; b < 8; ++b)
+            words[i] |= (uint64_t)planes[b * count + i] << 8 * b;
+    }
+}
+
+// bit i set where plane[i] differs from base
+void exceptions(const uint8_t* plane, std::size_t count, uint8_t base, uint8_t* bitmap)
+{
+    memset(bitmap, 0, (count + 7) / 8);
+    const __m128i vbase = _mm_set1_epi8(base);
+    std::size_t i = 0;
+    for(; i + 16 <= count; i += 16)
+    {
+        uint16_t differ = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(plane + i)), vbase));
+        memcpy(bitmap + i / 8, &differ, sizeof(differ));
+    }
+    for(; i < count; ++i)
+        bitmap[i / 8] |= (plane[i] != base) << i % 8;
+}
+
+template<typename F>
+void forEachBit(const uint8_t* bitmap, std::size_t count, F&& f)
+{
+    for(std::size_t word = 0; word * 64 < count; ++word)
+    {
+        uint64_t bits = 0;
+        memcpy(&bits, bitmap + word * 8, std::min<std::size_t>(8, (count + 7) / 8 - word * 8));
+        for(; bits; bits &= bits - 1)
+            f(word * 64 + std::countr_zero(bits));
+    }
+}
+
+std::byte* encode(const uint8_t* plane, std::size_t count, uint8_t* bitmap, std::byte* out)
+{
+    // constant planes are the ones worth packing, so the most common byte is nearly always at both ends
+    uint8_t base = plane[count / 2] == plane[count - 1] ? plane[count - 1] : plane[0];
+    exceptions(plane, count, base, bitmap);
+
+    std::size_t differ = 0;
+    for(std::size_t i = 0; i < (count + 7) / 8; ++i)
+        differ += std::popcount(bitmap[i]);
+
+    const std::size_t sparse = count <= 65536 ? 3 + 3 * differ : SIZE_MAX;
+    const std::size_t mask = 1 + (count + 7) / 8 + differ;
+
+    if(count <= std::min(sparse, mask))
+    {
+        *out++ = std::byte(Plane::Raw);
+        memcpy(out, plane, count);
+        return out + count;
+    }
+
+    if(sparse <= mask)
+    {
+        *out++ = std::byte(Plane::Sparse);
+        *out++ = std::byte(base);
+        uint16_t size = differ;
+        memcpy(out, &size, sizeof(size));
+        out += sizeof(size);
+        std::byte* bytes = out + differ * sizeof(uint16_t);
+        forEachBit(bitmap, count, [&](std::size_t i)
+        {
+            uint16_t position = i;
+            memcpy(out, &position, sizeof(position));
+            out += sizeof(position);
+            *bytes++ = std::byte(plane[i]);
+        });
+        return bytes;
+    }
+
+    *out++ = std::byte(Plane::Mask);
+    *out++ = std::byte(base);
+    memcpy(out, bitmap, (count + 7) / 8);
+    out += (count + 7) / 8;
+    forEachBit(bitmap, count, [&](std::size_t i) { *out++ = std::byte(plane[i]); });
+    return out;
+}
+
+// nullptr when input is malformed
+const std::byte* decode(const std::byte* in, const std::byte* end, std::size_t count, uint8_t* plane)
+{
+    if(in == end)
+        return nullptr;
+
+    switch(Plane(*in++))
+    {
+        case Plane::Raw:
+        {
+            if((std::size_t)(end - in) < count)
+                return nullptr;
+            memcpy(plane, in, count);
+            return in + count;
+        }
+        case Plane::Sparse:
+        {
+            uint16_t size;
+            if(end - in < 3)
+                return nullptr;
+            memset(plane, (uint8_t)in[0], count);
+            memcpy(&size, in + 1, sizeof(size));
+            in += 3;
+            if((std::size_t)(end - in) < size * 3u)
+                return nullptr;
+            const std::byte* bytes = in + size * sizeof(uint16_t);
+            for(uint16_t n = 0; n < size; ++n)
+            {
+                uint16_t position;
+                memcpy(&position, in + n * sizeof(position), sizeof(position));
+                if(position >= count)
+                    return nullptr;
+                plane[position] = (uint8_t)bytes[n];
+            }
+            return bytes + size;
+        }
+        case Plane::Mask:
+        {
+            const std::size_t bitmapSize = (count + 7) / 8;
+            if((std::size_t)(end - in) < 1 + bitmapSize)
+                return nullptr;
+            memset(plane, (uint8_t)in[0], count);
+            const uint8_t* bitmap = (const uint8_t*)in + 1;
+            in += 1 + bitmapSize;
+            bool fits = true;
+            forEachBit(bitmap, count, [&](std::size_t i)
+            {
+                if(i >= count || in == end)
+                    fits = false;
+                else
+                    plane[i] = (uint8_t)*in++;
+            });
+            return fits ? in : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+// page sized scratch, reused by every call of the thread
+struct Scratch
+{
+    std::vector<uint64_t>   words;
+    std::vector<uint8_t>    planes;
+    std::vector<uint8_t>    bitmap;
+
+    void reserve(std::size_t count)
+    {
+        words.resize(std::max(words.size(), count));
+        planes.resize(std::max(planes.size(), count * sizeof(uint64_t)));
+        bitmap.resize(std::max(bitmap.size(), (count + 7) / 8 + 8));
+    }
+};
+
+thread_local Scratch scratch;
+
+} // namespace
+
+std::size_t compress(const double* values, std::size_t count, Codec codec, std::byte* out)
+{
+    if(count == 0)
+        return 0;
+
+    if(codec == Codec::Raw)
+    {
+        memcpy(out, values, count * sizeof(double));
+        return count * sizeof(double);
+    }
+
+    scratch.reserve(count);
+    transform(values, count, codec, scratch.words.data());
+    shuffle(scratch.words.data(), count, scratch.planes.data());
+
+    std::byte* end = out;
+    for(int b = 0; b < 8; ++b)
+        end = encode(scratch.planes.data() + b * count, count, scratch.bitmap.data(), end);
+    return end - out;
+}
+
+bool decompress(const std::byte* in, std::size_t size, Codec codec, double* values, std::size_t count)
+{
+    if(count == 0)
+        return size == 0;
+
+    if(codec == Codec::Raw)
+    {
+        if(size != count * sizeof(double))
+            return false;
+        memcpy(values, in, size);
+        return true;
+    }
+
+    if(codec != Codec::Shuffle && codec != Codec::XorShuffle)
+        return false;
+
+    scratch.reserve(count);
+    const std::byte* end = in + size;
+    for(int b = 0; b < 8 && in; ++b)
+        in = decode(in, end, count, scratch.planes.data() + b * count);
+    if(in != end)
+        return false;
+
+    unshuffle(scratch.planes.data(), count, scratch.words.data());
+    restore(scratch.words.data(), count, codec, values);
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef UDP_SERVER_CODEC_H
+#define UDP_SERVER_CODEC_H
+
+#include "protocol.h"
+#include <cstddef>
+
+/*
+ * Lossless page codec for doubles. Every value is rotated left by one bit, so the exponent lands in
+ * the top byte, and bytes of values are shuffled into 8 planes by significance (SSE2 transpose).
+ * Random doubles of one range share most exponent bits, sorted ones share many more after XOR with
+ * the previous value (XorShuffle), so high planes are nearly constant. Every plane is stored raw,
+ * as base byte with list of exceptions, or as base byte with bitmap of exceptions, whichever is the
+ * shortest. Single pass over the page, no match search.
+*/
+
+// worst case of compress, which is never bigger than raw values plus a tag per plane
+inline constexpr std::size_t compressBound(std::size_t count) { return count * sizeof(double) + 8; }
+
+// returns size written to out
+std::size_t compress(const double* values, std::size_t count, Codec codec, std::byte* out);
+
+// false when input is malformed or doesn't decode to exactly count values
+bool decompress(const std::byte* in, std::size_t size, Codec codec, double* values, std::size_t count);
+
+#endif // UDP_SERVER_CODEC_H
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "crc32c.h"
+#include <array>
+#include <cstring>
+#include <immintrin.h>
+
+namespace
+{
+
+constexpr uint32_t POLY = 0x82F63B78; // reflected Castagnoli polynomial
+
+// block of one stream, both are powers of two so their shift operators are plain squarings
+constexpr std::size_t LONG = 8192;
+constexpr std::size_t SHORT = 256;
+
+using Table = std::array<std::array<uint32_t, 256>, 8>;
+using Shift = std::array<std::array<uint32_t, 256>, 4>;
+
+// slicing-by-8: table[k][b] is the crc of byte b followed by k zero bytes
+Table makeTable()
+{
+    Table table;
+    for(uint32_t b = 0; b < 256; ++b)
+    {
+        uint32_t crc = b;
+        for(int bit = 0; bit < 8; ++bit)
+            crc = crc & 1 ? (crc >> 1) ^ POLY : crc >> 1;
+        table[0][b] = crc;
+    }
+    for(uint32_t b = 0; b < 256; ++b)
+        for(int k = 1; k < 8; ++k)
+            table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xFF];
+    return table;
+}
+
+const Table table = makeTable();
+
+// crc is linear over GF(2): a 32x32 bit matrix (column per input bit) applies a run of zeros to it
+uint32_t times(const uint32_t* matrix, uint32_t vector)
+{
+    uint32_t sum = 0;
+    for(; vector; vector >>= 1, ++matrix)
+        if(vector & 1)
+            sum ^= *matrix;
+    return sum;
+}
+
+void square(uint32_t* result, const uint32_t* matrix)
+{
+    for(int n = 0; n < 32; ++n)
+        result[n] = times(matrix, matrix[n]);
+}
+
+// operator appending size zero bytes (power of two), as four tables indexed by bytes of the crc
+Shift makeShift(std::size_t size)
+{
+    uint32_t odd[32], even[32];
+    odd[0] = POLY; // one zero bit
+    for(int n = 1; n < 32; ++n)
+        odd[n] = 1u << (n - 1);
+    square(even, odd); // two bits
+    square(odd, even); // four bits
+
+    // first squaring gives one zero byte, every next one doubles it
+    const uint32_t* op = even;
+    for(;;)
+    {
+        square(even, odd);
+        op = even;
+        if((size >>= 1) == 0)
+            break;
+        square(odd, even);
+        op = odd;
+        if((size >>= 1) == 0)
+            break;
+    }
+
+    Shift shift;
+    for(uint32_t b = 0; b < 256; ++b)
+        for(int k = 0; k < 4; ++k)
+            shift[k][b] = times(op, b << (8 * k));
+    return shift;
+}
+
+const Shift shiftLong = makeShift(LONG);
+const Shift shiftShort = makeShift(SHORT);
+
+uint32_t shift(const Shift& zeros, uint32_t crc)
+{
+    return zeros[0][crc & 0xFF] ^ zeros[1][crc >> 8 & 0xFF] ^ zeros[2][crc >> 16 & 0xFF] ^ zeros[3][crc >> 24];
+}
+
+uint32_t crcPortable(const unsigned char* next, std::size_t size, uint32_t crc)
+{
+    crc = ~crc;
+    for(; size >= 8; size -= 8, next += 8)
+    {
+        uint64_t word;
+        memcpy(&word, next, sizeof(word));
+        word ^= crc;
+        crc = table[7][word & 0xFF] ^ table[6][word >> 8 & 0xFF] ^ table[5][word >> 16 & 0xFF] ^ table[4][word >> 24 & 0xFF]
+            ^ table[3][word >> 32 & 0xFF] ^ table[2][word >> 40 & 0xFF] ^ table[1][word >> 48 & 0xFF] ^ table[0][word >> 56];
+    }
+    for(; size; --size, ++next)
+        crc = (crc >> 8) ^ table[0][(crc ^ *next) & 0xFF];
+    return ~crc;
+}
+
+// three independent streams over consecutive blocks, the first one absorbs the other two
+__attribute__((target("sse4.2")))
+uint64_t streams(uint64_t crc0, const unsigned char*& next, std::size_t& size, std::size_t block, const Shift& zeros)
+{
+    for(; size >= 3 * block; size -= 3 * block, next += 3 * block)
+    {
+        uint64_t crc1 = 0, crc2 = 0;
+        for(std::size_t i = 0; i < block; i += 8)
+        {
+            uint64_t a, b, c;
+            memcpy(&a, next + i, 8);
+            memcpy(&b, next + block + i, 8);
+            memcpy(&c, next + 2 * block + i, 8);
+            crc0 = _mm_crc32_u64(crc0, a);
+            crc1 = _mm_crc32_u64(crc1, b);
+            crc2 = _mm_crc32_u64(crc2, c);
+        }
+        crc0 = shift(zeros, crc0) ^ crc1;
+        crc0 = shift(zeros, crc0) ^ crc2;
+    }
+    return crc0;
+}
+
+__attribute__((target("sse4.2")))
+uint32_t crcSse42(const unsigned char* next, std::size_t size, uint32_t crc)
+{
+    uint64_t crc0 = ~crc;
+
+    crc0 = streams(crc0, next, size, LONG, shiftLong);
+    crc0 = streams(crc0, next, size, SHORT, shiftShort);
+
+    for(; size >= 8; size -= 8, next += 8)
+    {
+        uint64_t word;
+        memcpy(&word, next, sizeof(word));
+        crc0 = _mm_crc32_u64(crc0, word);
+    }
+    for(; size; --size, ++next)
+        crc0 = _mm_crc32_u8(crc0, *next);
+    return ~(uint32_t)crc0;
+}
+
+using Kernel = uint32_t(*)(const unsigned char*, std::size_t, uint32_t);
+
+Kernel detect()
+{
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse4.2"))
+        return crcSse42;
+    return crcPortable;
+}
+
+} // namespace
+
+uint32_t crc32c(const void* data, std::size_t size, uint32_t crc)
+{
+    static const Kernel kernel = detect();
+    return kernel(static_cast<const unsigned char*>(data), size, crc);
+}
+
+uint32_t crc32cPortable(const void* data, std::size_t size, uint32_t crc)
+{
+    return crcPortable(static_cast<const unsigned char*>(data), size, crc);
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef UDP_SERVER_CRC32C_H
+#define UDP_SERVER_CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * CRC-32C (Castagnoli), the one of iSCSI and ext4, which x86 computes with the SSE4.2 crc32
+ * instruction. The instruction has latency of 3 and throughput of 1, so long buffers are cut into
+ * three streams computed together and joined by shifting the crc over zeros by tables.
+ * Kernel is chosen at runtime by CPU features, the portable one is slicing-by-8.
+ * crc continues a previous result, so crc32c(b, crc32c(a)) is the crc of a followed by b.
+*/
+uint32_t crc32c(const void* data, std::size_t size, uint32_t crc = 0);
+
+// always the portable kernel, same results
+uint32_t crc32cPortable(const void* data, std::size_t size, uint32_t crc = 0);
+
+#endif // UDP_SERVER_CRC32C_H
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include "logger.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+
+// single producer, single consumer ring of length prefixed lines
+struct FileLogger::Ring
+{
+    static constexpr uint64_t capacity = 256 << 10;
+    static constexpr uint64_t mask = capacity - 1;
+
+    std::thread::id                     owner;      // producing thread
+    std::unique_ptr<char[]>             data = std::make_unique<char[]>(capacity);
+    alignas(64) std::atomic<uint64_t>   head = 0;   // owned by drainer
+    alignas(64) std::atomic<uint64_t>   tail = 0;   // owned by producer
+
+    explicit Ring(std::thread::id owner)
+        : owner(owner)
+    {
+
+    }
+
+    void copyIn(uint64_t pos, const void* from, std::size_t size)
+    {
+        std::size_t first = std::min<std::size_t>(size, capacity - (pos & mask));
+        memcpy(data.get() + (pos & mask), from, first);
+        memcpy(data.get(), (const char*)from + first, size - first);
+    }
+
+    void copyOut(uint64_t pos, void* to, std::size_t size) const
+    {
+        std::size_t first = std::min<std::size_t>(size, capacity - (pos & mask));
+        memcpy(to, data.get() + (pos & mask), first);
+        memcpy((char*)to + first, data.get(), size - first);
+    }
+
+    // false when there is no room, line longer than half of the ring is cut
+    bool push(std::string_view line)
+    {
+        uint32_t size = std::min<std::size_t>(line.size(), capacity / 2);
+        uint64_t pos = tail.load(std::memory_order_relaxed);
+        if(pos + sizeof(size) + size - head.load(std::memory_order_acquire) > capacity)
+            return false;
+
+        copyIn(pos, &size, sizeof(size));
+        copyIn(pos + sizeof(size), line.data(), size);
+        tail.store(pos + sizeof(size) + size, std::memory_order_release);
+        return true;
+    }
+
+    // appends every line published so far
+    void pop(std::string& out)
+    {
+        uint64_t pos = head.load(std::memory_order_relaxed);
+        uint64_t end = tail.load(std::memory_order_acquire);
+
+        while(pos < end)
+        {
+            uint32_t size;
+            copyOut(pos, &size, sizeof(size));
+            std::size_t offset = out.size();
+            out.resize(offset + size);
+            copyOut(pos + sizeof(size), out.data() + offset, size);
+            pos += sizeof(size) + size;
+        }
+
+        head.store(pos, std::memory_order_release);
+    }
+};
+
+static std::atomic<uint64_t> loggers = 0;
+
+FileLogger::FileLogger(const std::string& name, Level level)
+    : Logger(level)
+    , m_File(::open(name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644))
+    , m_Id(++loggers)
+    , m_Drainer([this]() { drain(); })
+{
+
+}
+
+FileLogger::~FileLogger()
+{
+    m_Stop = true;
+    ++m_Lines;
+    m_Lines.notify_one();
+    m_Drainer.join();
+
+    if(m_File >= 0)
+        ::close(m_File);
+}
+
+FileLogger::Ring& FileLogger::ring()
+{
+    // (logger, ring) pairs of this thread, most recently used last; ids never repeat,
+    // so an entry left by a destroyed logger never matches and is evicted in time
+    static constexpr std::size_t cacheSize = 16;
+    thread_local std::vector<std::pair<uint64_t, Ring*>> rings;
+
+    auto cached = std::find_if(rings.begin(), rings.end(), [this](const auto& entry) { return entry.first == m_Id; });
+    if(cached != rings.end())
+    {
+        std::rotate(cached, cached + 1, rings.end());
+        return *rings.back().second;
+    }
+
+    if(rings.size() == cacheSize)
+        rings.erase(rings.begin());
+
+    // a thread evicted from the cache gets its ring back, so its lines stay in order
+    std::lock_guard _(m_RingsLock);
+    auto owner = std::this_thread::get_id();
+    auto found = std::find_if(m_Rings.begin(), m_Rings.end(), [owner](const auto& ring) { return ring->owner == owner; });
+    Ring* ring = found != m_Rings.end() ? found->get() : m_Rings.emplace_back(std::make_unique<Ring>(owner)).get();
+    rings.emplace_back(m_Id, ring);
+    return *ring;
+}
+
+void FileLogger::write(std::string_view message)
+{
+    std::string line = format(message);
+    Ring& ring = this->ring();
+
+    // drainer is behind, it's woken and given time instead of losing the line
+    while(!ring.push(line))
+    {
+        ++m_Lines;
+        m_Lines.notify_one();
+        std::this_thread::yield();
+    }
+
+    // seq_cst pairs with the drainer parking: either it's seen parked here, or it sees the count
+    // changed and doesn't sleep, so only a line finding it asleep pays for the wake syscall
+    m_Lines.fetch_add(1);
+    if(m_Parked.load())
+        m_Lines.notify_one();
+}
+
+void FileLogger::drain()
+{
+    std::string batch;
+
+    while(true)
+    {
+        // a line pushed after this load bumps the counter, so the wait below returns at once
+        uint32_t lines = m_Lines.load(std::memory_order_acquire);
+        bool stop = m_Stop;
+
+        {
+            std::lock_guard _(m_RingsLock);
+            for(auto& ring : m_Rings)
+                ring->pop(batch);
+        }
+
+        if(!batch.empty())
+        {
+            for(std::size_t written = 0; m_File >= 0 && written < batch.size();)
+            {
+                ssize_t count = ::write(m_File, batch.data() + written, batch.size() - written);
+                if(count <= 0)
+                    break;
+                written += count;
+            }
+            batch.clear();
+            continue;
+        }
+
+        if(stop)
+            return;
+
+        m_Parked.store(true);
+        m_Lines.wait(lines);
+        m_Parked.store(false, std::memory_order_relaxed);
+    }
+}
\ No newline at end of file
@@ -1,64 +1,127 @@
 #ifndef UDP_SERVER_LOGGER_H
 #define UDP_SERVER_LOGGER_H
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <ctime>
 #include <iostream>
-#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <boost/system/error_code.hpp>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+enum class Level : uint8_t { Debug, Info, Warning, Error };
+
+// "debug", "info", "warning" or "error"
+inline std::optional<Level> parseLevel(std::string_view name)
+{
+    constexpr std::string_view names[] = {"debug", "info", "warning", "error"};
+    for(uint8_t level = 0; level < std::size(names); ++level)
+        if(name == names[level])
+            return (Level)level;
+    return std::nullopt;
+}
 
 class Logger
 {
+    std::atomic<Level>  m_Level;
+
     protected:
         std::time_t now()
         {
             return std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
         }
 
+        // "time | message" line, newline included
+        std::string format(std::string_view message)
+        {
+            std::string line = std::to_string(now());
+            line.append(" | ").append(message).push_back('\n');
+            return line;
+        }
+
+        // message passed the level filter
+        virtual void write(std::string_view message) = 0;
+
     public:
-        virtual bool log(const boost::system::error_code&) = 0;
-        virtual void log(const std::string&) = 0;
+        Logger(Level level = Level::Info)
+            : m_Level(level)
+        {
+
+        }
+
+        virtual ~Logger() = default;
+
+        // inline and without a virtual call when there is no error, it's on every completion
+        bool log(const boost::system::error_code& error)
+        {
+            if(!error.failed()) [[likely]]
+                return false;
+            if(m_Level.load(std::memory_order_relaxed) <= Level::Error)
+                write(error.message());
+            return true;
+        }
+
+        void log(std::string_view message, Level level = Level::Info)
+        {
+            if(level >= m_Level.load(std::memory_order_relaxed))
+                write(message);
+        }
+
+        void setLevel(Level level) { m_Level.store(level, std::memory_order_relaxed); }
 };
 
+/*
+ * Appends to a file from a background thread. Every producing thread formats its line and
+ * copies it into its own single-producer ring, so logging takes no lock and never writes on
+ * the calling thread; the drainer parks on a futex while rings are empty, and only a line
+ * which finds it parked pays for the wake syscall, lines logged while it drains don't. It
+ * writes everything collected from all rings with one write call. Lines of one
+ * thread keep their order. A producer whose ring is full waits for the drainer instead of
+ * dropping the line. Destructor writes out everything logged before it.
+*/
 class FileLogger : public Logger
 {
-    std::ofstream   m_Logfile;
-
-public:
-    FileLogger(const std::string& name)
-        : m_Logfile(name, std::ios::app)
-    {
-
-    }
-
-    bool log(const boost::system::error_code& error) override
-    {
-        if(error.failed())
-            m_Logfile << now() << " | " << error.message() << std::endl;
-        return error.failed();
-    }
-
-    void log(const std::string& message) override
-    {
-        m_Logfile << now() << " | " << message << std::endl;
-    }
+    struct Ring;
+
+    int                                 m_File;
+    uint64_t                            m_Id;       // tells loggers apart in per-thread ring caches
+    std::mutex                          m_RingsLock; // taken when a thread misses its ring cache
+    std::vector<std::unique_ptr<Ring>>  m_Rings;
+    std::atomic<uint32_t>               m_Lines = 0; // bumped by producers, drainer parks on it
+    std::atomic<bool>                   m_Parked = false; // drainer sleeps, next line has to wake it
+    std::atomic<bool>                   m_Stop = false;
+    std::jthread                        m_Drainer;
+
+    private:
+        Ring& ring();
+        void drain();
+
+    protected:
+        void write(std::string_view message) override;
+
+    public:
+        FileLogger(const std::string& name, Level level = Level::Info);
+        ~FileLogger();
 };
 
+// synchronous, for tools and benchmarks
 class CoutLogger : public Logger
 {
-public:
-    bool log(const boost::system::error_code& error) override
-    {
-        if(error.failed())
-            std::cout << now() << " | " << error.message() << std::endl;
-        return error.failed();
-    }
-
-    void log(const std::string& message) override
-    {
-        std::cout << now() << " | " << message << std::endl;
-    }
+    std::mutex  m_Lock;
+
+    protected:
+        void write(std::string_view message) override
+        {
+            std::lock_guard _(m_Lock);
+            std::cout << format(message) << std::flush;
+        }
 };
 
 #endif // UDP_SERVER_LOGGER_H
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "merge.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <functional>
+#include <limits>
+#include <thread>
+
+namespace
+{
+
+constexpr std::size_t sampleStep = 64;       // every sampleStep-th value of a run is a splitter candidate
+constexpr std::size_t minChunk = 1 << 15;    // smaller chunks are not worth a thread
+
+// tournament over heads of runs, every inner node keeps the loser of its match and the winner moves up,
+// so replacing the winner replays a single path of log(runs) matches, one comparison each
+class LoserTree
+{
+    std::vector<uint32_t>   m_Tree; // [0] is the overall winner
+    std::vector<double>     m_Heads;
+    uint32_t                m_Leaves;
+
+    uint32_t build(uint32_t node)
+    {
+        if(node >= m_Leaves)
+            return node - m_Leaves;
+
+        uint32_t left = build(2 * node);
+        uint32_t right = build(2 * node + 1);
+        bool leftWins = m_Heads[left] > m_Heads[right];
+        m_Tree[node] = leftWins ? right : left;
+        return leftWins ? left : right;
+    }
+
+    public:
+        // exhausted runs hold -infinity and never win while anything is left
+        explicit LoserTree(uint32_t runs)
+            : m_Tree(std::bit_ceil(std::max(runs, 1u)))
+            , m_Heads(m_Tree.size(), -std::numeric_limits<double>::infinity())
+            , m_Leaves(m_Tree.size())
+        {
+
+        }
+
+        double& head(uint32_t run)
+        {
+            return m_Heads[run];
+        }
+
+        void build()
+        {
+            m_Tree[0] = build(1);
+        }
+
+        uint32_t winner() const
+        {
+            return m_Tree[0];
+        }
+
+        // after head of winner has changed
+        void replay()
+        {
+            uint32_t winner = m_Tree[0];
+            double value = m_Heads[winner];
+            // path doesn't depend on outcomes, so loads overlap, and the match is decided by masks and max
+            // instead of a branch mispredicted every other time on random data
+            for(uint32_t node = (winner + m_Leaves) / 2; node > 0; node /= 2)
+            {
+                uint32_t other = m_Tree[node];
+                double challenger = m_Heads[other];
+                uint32_t swap = (winner ^ other) & -(uint32_t)(challenger > value);
+                m_Tree[node] = other ^ swap;
+                winner ^= swap;
+                value = std::max(value, challenger);
+            }
+            m_Tree[0] = winner;
+        }
+};
+
+} // namespace
+
+void mergeDescending(const std::vector<std::span<const double>>& runs, std::span<double> out, uint32_t threads)
+{
+    std::size_t total = 0;
+    for(auto& run : runs)
+        total += run.size();
+    assert(out.size() >= total);
+
+    threads = std::clamp<std::size_t>(total / minChunk, 1, std::max(1u, threads));
+
+    std::vector<double> splitters;
+    if(threads > 1)
+    {
+        std::vector<double> samples;
+        samples.reserve(total / sampleStep + runs.size());
+        for(auto& run : runs)
+            for(std::size_t i = 0; i < run.size(); i += sampleStep)
+                samples.push_back(run[i]);
+        std::sort(samples.begin(), samples.end(), std::greater<>());
+
+        for(uint32_t thread = 1; thread < threads; ++thread)
+            splitters.push_back(samples[samples.size() * thread / threads]);
+    }
+
+    // bounds[thread * runs + run] is where part of the thread starts in the run, values above splitter go before it
+    std::vector<std::size_t> bounds((threads + 1) * runs.size());
+    for(std::size_t r = 0; r < runs.size(); ++r)
+    {
+        bounds[r] = 0;
+        for(uint32_t thread = 1; thread < threads; ++thread)
+            bounds[thread * runs.size() + r] = std::lower_bound(runs[r].begin(), runs[r].end(), splitters[thread - 1], std::greater<>()) - runs[r].begin();
+        bounds[threads * runs.size() + r] = runs[r].size();
+    }
+
+    auto worker = [&](uint32_t thread)
+    {
+        const std::size_t* begin = bounds.data() + thread * runs.size();
+        const std::size_t* end = begin + runs.size();
+
+        std::size_t offset = 0;
+        for(std::size_t r = 0; r < runs.size(); ++r)
+            offset += begin[r];
+
+        std::vector<std::size_t> position(begin, end);
+        std::size_t count = 0;
+        LoserTree tree(runs.size());
+        for(uint32_t r = 0; r < runs.size(); ++r)
+        {
+            count += end[r] - begin[r];
+            if(position[r] < end[r])
+                tree.head(r) = runs[r][position[r]];
+        }
+        tree.build();
+
+        double* dst = out.data() + offset;
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            uint32_t run = tree.winner();
+            double& head = tree.head(run);
+            dst[i] = head;
+            head = ++position[run] < end[run] ? runs[run][position[run]] : -std::numeric_limits<double>::infinity();
+            tree.replay();
+        }
+    };
+
+    std::vector<std::jthread> helpers;
+    for(uint32_t thread = 1; thread < threads; ++thread)
+        helpers.emplace_back(worker, thread);
+    worker(0);
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef UDP_SERVER_MERGE_H
+#define UDP_SERVER_MERGE_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/*
+ * Merges runs sorted descending into out, which must hold all of them.
+ * Output is cut into ranges of values by splitters sampled from the runs, every thread
+ * finds its range in every run by binary search and merges it with a heap to its own
+ * part of out, so threads never touch the same memory. Values are expected to be unique.
+*/
+void mergeDescending(const std::vector<std::span<const double>>& runs, std::span<double> out, uint32_t threads = 1);
+
+#endif // UDP_SERVER_MERGE_H
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "parity.h"
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+namespace
+{
+
+void xorScalar(double* dst, const double* src, std::size_t count)
+{
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        uint64_t a, b;
+        memcpy(&a, dst + i, sizeof(a));
+        memcpy(&b, src + i, sizeof(b));
+        a ^= b;
+        memcpy(dst + i, &a, sizeof(a));
+    }
+}
+
+__attribute__((target("avx2")))
+void xorAvx2(double* dst, const double* src, std::size_t count)
+{
+    std::size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256i a0 = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i a1 = _mm256_loadu_si256((const __m256i*)(dst + i + 4));
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(src + i + 4));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(a0, b0));
+        _mm256_storeu_si256((__m256i*)(dst + i + 4), _mm256_xor_si256(a1, b1));
+    }
+
+    xorScalar(dst + i, src + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+void xorAvx512(double* dst, const double* src, std::size_t count)
+{
+    std::size_t i = 0;
+    for(; i + 16 <= count; i += 16)
+    {
+        __m512i a0 = _mm512_loadu_si512(dst + i);
+        __m512i a1 = _mm512_loadu_si512(dst + i + 8);
+        __m512i b0 = _mm512_loadu_si512(src + i);
+        __m512i b1 = _mm512_loadu_si512(src + i + 8);
+        _mm512_storeu_si512(dst + i, _mm512_xor_si512(a0, b0));
+        _mm512_storeu_si512(dst + i + 8, _mm512_xor_si512(a1, b1));
+    }
+
+    xorScalar(dst + i, src + i, count - i);
+}
+
+using Kernel = void(*)(double*, const double*, std::size_t);
+
+Kernel detect()
+{
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f"))
+        return xorAvx512;
+    if(__builtin_cpu_supports("avx2"))
+        return xorAvx2;
+    return xorScalar;
+}
+
+} // namespace
+
+void xorInto(double* dst, const double* src, std::size_t count)
+{
+    static const Kernel kernel = detect();
+    kernel(dst, src, count);
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#ifndef UDP_SERVER_PARITY_H
+#define UDP_SERVER_PARITY_H
+
+#include <cstddef>
+
+/*
+ * Forward error correction by XOR: parity page of a group is XOR of its data pages (shorter
+ * ones padded by zeros), so XOR of the parity with all data pages but one gives that one back.
+ * dst ^= src bit by bit, by AVX-512 or AVX2 kernel chosen at runtime by CPU features,
+ * with a scalar fallback.
+*/
+void xorInto(double* dst, const double* src, std::size_t count);
+
+#endif // UDP_SERVER_PARITY_H
\ No newline at end of file
@@ -0,0 +1,93 @@
+#ifndef UDP_SERVER_PROTOCOL_H
+#define UDP_SERVER_PROTOCOL_H
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+inline constexpr uint16_t PROTOCOL_MAGIC = 0x5544;  // "DU" on the wire
+inline constexpr uint8_t  PROTOCOL_VERSION = 3;
+
+// request flags
+inline constexpr uint64_t FLAG_SORTED = 1 << 0; // dataset is sorted descending by server, pages arrive ordered
+inline constexpr uint64_t FLAG_DETERMINISTIC = 1 << 1; // (seed, nonce) determine the dataset, repeats may be served from cache
+inline constexpr uint64_t FLAG_MULTICAST = 1 << 2; // deterministic dataset may come through multicast group shared with others
+
+// type of datagram, receivers dispatch by it
+enum class Message : uint8_t
+{
+    Request,    // client: Request follows
+    Data,       // server: page values follow
+    End,        // server: all pages (re)sent, client answers with Nack or Ack
+    Nack,       // client: bitmap of received pages follows, bit set = page is in
+    Ack,        // client: whole dataset is in, session may be dropped
+    Refuse,     // server: error text follows
+    Subscribe,  // server: Subscription follows, pages go to multicast group, lost ones are asked for as usual
+    Stats,      // any: asks for server stats; server: JSON text follows
+};
+
+// encoding of values of Data page, see common/codec.h
+enum class Codec : uint8_t
+{
+    Raw,
+    Shuffle,        // byte planes by significance, nearly constant ones packed
+    XorShuffle,     // same over XOR with previous value, for sorted pages
+};
+
+// leads every datagram in both directions; a page is placed by index wherever and whenever
+// it arrives, and any server datagram tells the layout. Size keeps the values behind it aligned
+struct Header
+{
+    uint16_t    magic = PROTOCOL_MAGIC;
+    uint8_t     version = PROTOCOL_VERSION;
+    Message     type;
+    uint32_t    session = 0;    // picked by client, echoed in every reply
+    uint32_t    index = 0;      // Data: data pages first, parity pages after them; Nack: first page of bitmap
+    uint32_t    pages = 0;      // Data, End: data pages in dataset; Nack: pages covered by bitmap
+    uint16_t    size = 0;       // values in every data page but the last
+    uint16_t    tail = 0;       // values in the last data page
+    uint32_t    group = 0;      // data pages covered by one parity page, 0 without FEC
+    uint32_t    crc = 0;        // Data: CRC32C of header (this field zero) and payload
+    Codec       codec = Codec::Raw;
+    uint8_t     reserved[3] = {};
+};
+
+static_assert(sizeof(Header) == 32);
+static_assert(std::is_trivially_copyable_v<Header>);
+
+// follows header of the first datagram of client
+struct Request
+{
+    double      seed;
+    uint64_t    flags = 0;
+    uint64_t    nonce = 0;      // with FLAG_DETERMINISTIC, tells datasets of the same seed apart
+};
+
+static_assert(sizeof(Request) == 24);
+static_assert(std::is_trivially_copyable_v<Request>);
+
+// follows header of Subscribe, which carries the layout like End
+struct Subscription
+{
+    uint8_t     group[16] = {}; // IPv6 address, IPv4 one mapped
+    uint16_t    port = 0;
+    uint16_t    reserved = 0;
+    uint32_t    session = 0;    // in headers of datagrams sent to the group
+};
+
+static_assert(sizeof(Subscription) == 24);
+static_assert(std::is_trivially_copyable_v<Subscription>);
+
+// wire struct out of received bytes, whatever type the receive buffer has
+template<typename T>
+T fromWire(const void* data)
+{
+    std::array<std::byte, sizeof(T)> bytes;
+    memcpy(bytes.data(), data, sizeof(T));
+    return std::bit_cast<T>(bytes);
+}
+
+#endif // UDP_SERVER_PROTOCOL_H
\ No newline at end of file
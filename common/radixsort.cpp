@@ -0,0 +1,117 @@
+#include "radixsort.h"
+#include <algorithm>
+#include <array>
+#include <barrier>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr uint32_t digitBits = 11;
+constexpr uint32_t buckets = 1 << digitBits;
+constexpr uint32_t passes = (64 + digitBits - 1) / digitBits;
+constexpr std::size_t minChunk = 1 << 14; // smaller chunks are not worth a thread
+constexpr std::size_t minSize = 1 << 11;  // below that histograms cost more than comparisons
+
+using Histogram = std::array<uint32_t, buckets>;
+
+// ascending order of keys is descending order of doubles
+uint64_t key(double value)
+{
+    uint64_t bits = std::bit_cast<uint64_t>(value);
+    uint64_t ascending = bits >> 63 ? ~bits : bits | (1ull << 63);
+    return ~ascending;
+}
+
+uint32_t digit(double value, uint32_t pass)
+{
+    return (key(value) >> (pass * digitBits)) & (buckets - 1);
+}
+
+} // namespace
+
+void radixSortDescending(std::span<double> data, std::span<double> scratch, uint32_t threads)
+{
+    assert(scratch.size() >= data.size());
+
+    const std::size_t size = data.size();
+    if(size < minSize)
+    {
+        std::sort(data.begin(), data.end(), std::greater<>());
+        return;
+    }
+
+    threads = std::clamp<std::size_t>(size / minChunk, 1, std::max(1u, threads));
+
+    std::vector<Histogram> counts(threads); // digit counts of every chunk, turned to scatter offsets
+    double* src = data.data();
+    double* dst = scratch.data();
+    bool counted = false;
+    bool skip = false;
+
+    // runs on the last thread arriving to barrier, alternately after counting and after scattering
+    auto completion = [&]() noexcept
+    {
+        counted = !counted;
+
+        if(!counted)
+        {
+            if(!skip)
+                std::swap(src, dst);
+            return;
+        }
+
+        uint32_t offset = 0;
+        skip = false;
+        for(uint32_t b = 0; b < buckets; ++b)
+        {
+            uint32_t begin = offset;
+            for(auto& count : counts)
+            {
+                uint32_t n = count[b];
+                count[b] = offset;
+                offset += n;
+            }
+            skip |= offset - begin == size;
+        }
+    };
+
+    std::barrier sync(threads, completion);
+
+    auto worker = [&](uint32_t thread)
+    {
+        const std::size_t begin = size * thread / threads;
+        const std::size_t end = size * (thread + 1) / threads;
+        auto& count = counts[thread];
+
+        for(uint32_t pass = 0; pass < passes; ++pass)
+        {
+            count.fill(0);
+            for(std::size_t i = begin; i < end; ++i)
+                ++count[digit(src[i], pass)];
+
+            sync.arrive_and_wait();
+
+            if(!skip)
+                for(std::size_t i = begin; i < end; ++i)
+                    dst[count[digit(src[i], pass)]++] = src[i];
+
+            sync.arrive_and_wait();
+        }
+    };
+
+    {
+        std::vector<std::jthread> helpers;
+        for(uint32_t thread = 1; thread < threads; ++thread)
+            helpers.emplace_back(worker, thread);
+        worker(0);
+    }
+
+    if(src != data.data())
+        memcpy(data.data(), src, size * sizeof(double));
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#ifndef UDP_SERVER_RADIX_SORT_H
+#define UDP_SERVER_RADIX_SORT_H
+
+#include <cstdint>
+#include <span>
+
+/*
+ * LSD radix sort of doubles in descending order, 6 passes of 11 bit digits over the bit pattern
+ * turned into unsigned key (sign flipped for positives, all bits flipped for negatives, then inverted).
+ * Every pass: threads count digits of their chunk, offsets are laid out bucket by bucket
+ * and thread by thread, then every thread scatters its chunk, so the sort is stable.
+ * Passes where all values share the digit are skipped, short inputs fall back to std::sort.
+ * Scratch must be at least as big as data, result is in data.
+*/
+void radixSortDescending(std::span<double> data, std::span<double> scratch, uint32_t threads = 1);
+
+#endif // UDP_SERVER_RADIX_SORT_H
\ No newline at end of file
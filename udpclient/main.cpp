@@ -1,7 +1,9 @@
 
 #include "udpclient.h"
 #include <filesystem>
+#include <iostream>
 #include <nlohmann/json.hpp>
+#include <optional>
 #include <stdexcept>
 #include <fstream>
 
@@ -31,11 +33,36 @@ int main(int argc, char *argv[])
         throw std::runtime_error("address must be string value");
     if(!config_json["port"].is_number_unsigned())
         throw std::runtime_error("seed must be unsigned value");
+    if(config_json.contains("sorted") && !config_json["sorted"].is_boolean())
+        throw std::runtime_error("sorted must be boolean value");
+    if(config_json.contains("nonce") && !config_json["nonce"].is_number_unsigned())
+        throw std::runtime_error("nonce must be unsigned value");
+    if(config_json.contains("multicast") && !config_json["multicast"].is_boolean())
+        throw std::runtime_error("multicast must be boolean value");
+    if(config_json.contains("stats") && !config_json["stats"].is_boolean())
+        throw std::runtime_error("stats must be boolean value");
+
+    // only asks for server stats
+    if(config_json.value("stats", false))
+    {
+        std::string stats = UDPClient::queryStats(config_json["address"], config_json["port"]);
+        if(stats.empty())
+            throw std::runtime_error("no stats from server");
+        std::cout << stats << std::endl;
+        return 0;
+    }
     
     fs::path out = fs::path("output/").append(config.c_str());
     out.replace_extension(".bin");
+    fs::create_directories(out.parent_path());
+
+    // nonce asks for deterministic dataset
+    std::optional<uint64_t> nonce;
+    if(config_json.contains("nonce"))
+        nonce = config_json["nonce"];
 
-    UDPClient client(config_json["seed"], config_json["address"], config_json["port"], out.c_str());
+    UDPClient client(config_json["seed"], config_json["address"], config_json["port"], out.c_str(), config_json.value("sorted", false), nonce,
+        config_json.value("multicast", false));
     
     client.waitUntilEnd();
 
@@ -0,0 +1,73 @@
+#include "mappedfile.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace
+{
+
+boost::system::error_code lastError()
+{
+    return boost::system::error_code(errno, boost::system::system_category());
+}
+
+} // namespace
+
+MappedFile::~MappedFile()
+{
+    close(m_Capacity);
+}
+
+boost::system::error_code MappedFile::create(const std::string& path, std::size_t capacity)
+{
+    close(m_Capacity);
+
+    m_File = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(m_File == -1)
+        return lastError();
+
+    // not every filesystem can reserve blocks, size is set anyway
+    if(fallocate(m_File, 0, 0, capacity * sizeof(double)) == -1 && errno != EOPNOTSUPP)
+        return lastError();
+    if(ftruncate(m_File, capacity * sizeof(double)) == -1)
+        return lastError();
+
+    m_Capacity = capacity;
+    if(capacity == 0)
+        return {};
+
+    void* data = mmap(nullptr, capacity * sizeof(double), PROT_READ | PROT_WRITE, MAP_SHARED, m_File, 0);
+    if(data == MAP_FAILED)
+        return lastError();
+    m_Data = static_cast<double*>(data);
+
+    // every page is written, fault them all in one call instead of one write fault per page
+    // (kernel 5.14+, pages fault on first touch otherwise)
+    madvise(m_Data, capacity * sizeof(double), MADV_POPULATE_WRITE);
+    return {};
+}
+
+boost::system::error_code MappedFile::close(std::size_t count)
+{
+    boost::system::error_code error;
+
+    if(m_Data)
+        munmap(m_Data, m_Capacity * sizeof(double));
+    if(m_File != -1)
+    {
+        if(count < m_Capacity && ftruncate(m_File, count * sizeof(double)) == -1)
+            error = lastError();
+        ::close(m_File);
+    }
+
+    m_Data = nullptr;
+    m_File = -1;
+    m_Capacity = 0;
+    return error;
+}
+
+std::span<double> MappedFile::data() const
+{
+    return {m_Data, m_Capacity};
+}
\ No newline at end of file
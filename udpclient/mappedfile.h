@@ -0,0 +1,36 @@
+#ifndef UDP_SERVER_MAPPED_FILE_H
+#define UDP_SERVER_MAPPED_FILE_H
+
+#include <boost/system/error_code.hpp>
+#include <cstddef>
+#include <span>
+#include <string>
+
+/*
+ * Output file written through a shared memory mapping: values are stored straight to the page cache,
+ * without a copy through a stream buffer. File is created with the upper bound of its size and its
+ * disk blocks are reserved by fallocate, so writing to the mapping can't fail on a full disk (SIGBUS)
+ * and the file is not fragmented by growing; the unused tail is cut off on close.
+*/
+class MappedFile
+{
+    int         m_File = -1;
+    double*     m_Data = nullptr;
+    std::size_t m_Capacity = 0;
+
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile();
+
+        // creates file of capacity doubles and maps it for writing
+        boost::system::error_code create(const std::string& path, std::size_t capacity);
+
+        // unmaps and closes, file keeps first count doubles
+        boost::system::error_code close(std::size_t count);
+
+        std::span<double> data() const;
+};
+
+#endif // UDP_SERVER_MAPPED_FILE_H
\ No newline at end of file
@@ -1,29 +1,41 @@
 #include "udpclient.h"
+#include "../common/codec.h"
+#include "../common/crc32c.h"
+#include "../common/merge.h"
+#include "../common/parity.h"
+#include "../common/radixsort.h"
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <boost/asio/steady_timer.hpp>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
-#include <execution>
-#include <fstream>
 #include <iostream>
 #include <memory>
-#include <set>
+#include <random>
+#include <span>
+#include <string>
 
-UDPClient::UDPClient(double seed, std::string dest, uint16_t port, std::string output)
-    : m_Seed(seed)
-    , m_Response(ceil((float)MAX_PAGE_SIZE / sizeof(double)), 0.0)
+UDPClient::UDPClient(double seed, std::string dest, uint16_t port, std::string output, bool sorted, std::optional<uint64_t> nonce,
+    bool multicast)
+    : m_Request{seed, (sorted ? FLAG_SORTED : 0) | (nonce ? FLAG_DETERMINISTIC : 0) | (multicast ? FLAG_MULTICAST : 0), nonce.value_or(0)}
+    , m_Session(std::random_device()())
+    , m_Incoming(std::make_unique_for_overwrite<double[]>((MAX_PAGE_SIZE + sizeof(double) - 1) / sizeof(double)))
+    , m_Worker([this](){sortAndWrite();})
+    , m_output(output)
     , m_Context()
     , m_Socket(m_Context, udp::endpoint(udp::v6(), 0))
     , m_Server(boost::asio::ip::address::from_string(dest), port)
+    , m_GroupSocket(m_Context)
     , m_Delay(m_Context)
-    , m_Worker([this](){sortAndWrite();})
-    , m_output(output)
+    , m_Idle(m_Context)
     , m_Log(std::make_shared<FileLogger>(m_output + ".log"))
 {
+    m_Socket.set_option(boost::asio::socket_base::receive_buffer_size(RECEIVE_BUFFER_SIZE));
     pushSeed();
-    receive(m_Response.data(), MAX_PAGE_SIZE);
+    receive(m_Socket, m_Incoming.get(), m_Server);
     m_Context.run();
 }
 
@@ -33,52 +45,196 @@ void UDPClient::pushSeed()
     m_Delay.async_wait([=, this](const boost::system::error_code& error)
     {
         m_Log->log(error);
-        m_Socket.send_to(boost::asio::buffer(&m_Seed, 8), m_Server);
+        send({.type = Message::Request}, boost::asio::buffer(&m_Request, sizeof(m_Request)));
+        watchIdle(m_Datagrams);
     });
 }
 
-void UDPClient::receive(double* shift, uint32_t size)
+void UDPClient::watchIdle(uint32_t datagrams)
 {
-    m_Socket.async_receive_from(boost::asio::buffer(shift, size), m_Server,
-    [=, this](const boost::system::error_code& error, std::size_t recvd)
+    m_Idle.expires_after(IDLE_TIMEOUT);
+    m_Idle.async_wait([=, this](const boost::system::error_code& error)
     {
+        if(error == boost::asio::error::operation_aborted)
+            return;
         m_Log->log(error);
-        if(recvd == 1) // opCode
-        {
+
+        // before the first page there is nothing to ask for, generation may just take long
+        if(datagrams == m_Datagrams && m_PerPage)
             processPing();
-            if(!m_allDataReached)
-                receive(shift, size);
-        }
-        else if((recvd - 2) % 8 == 0) // checksum branch
-        {
-            processChecksums(shift, size, recvd);
-            if(!m_allDataReached)
-            {
-                double* newShift = m_Response.data() + m_ReceivedPages.size() * (m_PageSize / sizeof(double));
-                receive(newShift, (&*m_Response.end() - newShift) * sizeof(double));
-            }
-        }
-        else if(recvd % 8 == 0) // data branch
+        watchIdle(m_Datagrams);
+    });
+}
+
+void UDPClient::receive(udp::socket& socket, double* buffer, udp::endpoint& sender)
+{
+    socket.async_receive_from(boost::asio::buffer(buffer, MAX_PAGE_SIZE), sender,
+    [this, &socket, buffer, &sender](const boost::system::error_code& error, std::size_t recvd)
+    {
+        // cancelled once everything is in
+        if(error == boost::asio::error::operation_aborted)
+            return;
+        m_Log->log(error);
+        ++m_Datagrams;
+
+        Header header;
+        if(!error && recvd >= sizeof(header))
+            header = fromWire<Header>(buffer);
+        else
+            header.magic = 0;
+
+        // the group only carries pages and End of the round
+        bool group = m_GroupSession && header.session == m_GroupSession && (header.type == Message::Data || header.type == Message::End);
+
+        if(header.magic != PROTOCOL_MAGIC || (header.session != m_Session && !group))
+            ; // stray datagram, e.g. late page of previous session
+
+        else if(header.version != PROTOCOL_VERSION)
         {
-            processData(shift, size, recvd);
+            refused("unsupported protocol version " + std::to_string(header.version));
+            return;
         }
-        else // unknown branch
+
+        else switch(header.type)
         {
-            std::string msg;
-            memcpy(&msg, shift, recvd);
-            m_Log->log(msg);
+            case Message::Data:
+                processData(header, buffer + sizeof(header) / sizeof(double), recvd - sizeof(header));
+                break;
+            case Message::End:
+                layout(header);
+                processPing();
+                break;
+            case Message::Subscribe:
+                layout(header);
+                if(recvd - sizeof(header) == sizeof(Subscription))
+                    subscribe(fromWire<Subscription>(buffer + sizeof(header) / sizeof(double)));
+                break;
+            case Message::Refuse:
+                refused(std::string(reinterpret_cast<const char*>(buffer) + sizeof(header), recvd - sizeof(header)));
+                return;
+            default:
+                m_Log->log("unexpected message", Level::Warning);
         }
+
+        if(!m_allDataReached)
+            receive(socket, buffer, sender);
     });
 }
 
+// joins the group on the interface routing picks for it; if joining fails pages are never seen
+// and the client asks for all of them once idle, like for any lost ones
+void UDPClient::subscribe(const Subscription& subscription)
+{
+    if(m_GroupSession)
+        return;
+
+    boost::asio::ip::address_v6::bytes_type bytes;
+    std::copy_n(subscription.group, bytes.size(), bytes.begin());
+    boost::asio::ip::address_v6 v6(bytes);
+    boost::asio::ip::address group = v6.is_v4_mapped() ? boost::asio::ip::address(boost::asio::ip::make_address_v4(boost::asio::ip::v4_mapped, v6))
+        : boost::asio::ip::address(v6);
+    auto protocol = group.is_v4() ? udp::v4() : udp::v6();
+
+    boost::system::error_code error;
+    m_GroupSocket.open(protocol, error);
+    // other clients on this host listen on the same port
+    if(!error)
+        m_GroupSocket.set_option(boost::asio::socket_base::reuse_address(true), error);
+    if(!error)
+        m_GroupSocket.bind(udp::endpoint(protocol, subscription.port), error);
+    if(!error)
+        m_GroupSocket.set_option(boost::asio::ip::multicast::join_group(group), error);
+    if(!error)
+        m_GroupSocket.set_option(boost::asio::socket_base::receive_buffer_size(RECEIVE_BUFFER_SIZE), error);
+
+    if(m_Log->log(error))
+    {
+        m_GroupSocket.close(error);
+        return;
+    }
+
+    m_GroupSession = subscription.session;
+    m_GroupIncoming = std::make_unique_for_overwrite<double[]>((MAX_PAGE_SIZE + sizeof(double) - 1) / sizeof(double));
+    receive(m_GroupSocket, m_GroupIncoming.get(), m_GroupSender);
+}
+
+void UDPClient::pushPage(std::span<double> page)
+{
+    {
+        std::lock_guard lock(m_PagesLock);
+        m_Pages.push_back(page);
+    }
+    m_PagesArrived.notify_one();
+}
+
+void UDPClient::finish()
+{
+    m_Idle.cancel();
+    // the other socket may still wait for a datagram
+    boost::system::error_code ignored;
+    m_Socket.cancel(ignored);
+    m_GroupSocket.close(ignored);
+    {
+        std::lock_guard lock(m_PagesLock);
+        m_Finished = true;
+        m_LastPage = std::chrono::steady_clock::now();
+    }
+    m_PagesArrived.notify_one();
+}
+
 void UDPClient::sortAndWrite()
 {
-    m_DataReady.wait(false);
+    using clock = std::chrono::steady_clock;
+    auto ms = [](clock::duration d) { return std::to_string(std::chrono::duration<double, std::milli>(d).count()); };
 
-    std::sort(std::execution::par_unseq, m_Response.begin(), m_Response.end(), [](double a, double b){return a > b;});
+    std::vector<std::span<const double>> runs;
+    std::vector<double> scratch;
+    clock::duration sorting{};
+    clock::time_point firstPage;
 
-    std::ofstream outFile(m_output, std::ios::out | std::ios::binary);
-    outFile.write((char*)m_Response.data(), sizeof(double) * m_Response.size());
+    // every page is sorted as soon as it lands, so only merge is left after the last one;
+    // sorted pages go straight to the output and never come here
+    while(true)
+    {
+        std::span<double> page;
+        {
+            std::unique_lock lock(m_PagesLock);
+            m_PagesArrived.wait(lock, [this]() { return m_Finished || !m_Pages.empty(); });
+            if(m_Pages.empty())
+                break;
+            page = m_Pages.front();
+            m_Pages.pop_front();
+        }
+
+        auto begin = clock::now();
+        if(runs.empty())
+            firstPage = begin;
+
+        scratch.resize(std::max(scratch.size(), page.size()));
+        radixSortDescending(page, scratch);
+        runs.push_back(page);
+        sorting += clock::now() - begin;
+    }
+
+    if(m_Aborted)
+        return;
+
+    auto merging = clock::now();
+    auto sortTail = merging - m_LastPage;
+    const std::size_t total = (std::size_t)(m_PagesCount - 1) * m_PerPage + m_Tail;
+
+    if(!runs.empty())
+        mergeDescending(runs, m_OutFile.data(), std::max(1u, std::thread::hardware_concurrency()));
+
+    auto closing = clock::now();
+    if(auto error = m_OutFile.close(total))
+        m_Log->log(error);
+
+    if(runs.empty())
+        m_Log->log("unmap " + ms(clock::now() - closing) + " ms");
+    else
+        m_Log->log("receive " + ms(m_LastPage - firstPage) + " ms, page sort " + ms(sorting) + " ms (" + ms(sortTail) +
+            " ms after last page), merge " + ms(closing - merging) + " ms, unmap " + ms(clock::now() - closing) + " ms");
 }
 
 void UDPClient::waitUntilEnd()
@@ -87,98 +243,232 @@ void UDPClient::waitUntilEnd()
         m_Worker.join();
 }
 
-void UDPClient::processChecksums(double* shift, uint32_t size, uint32_t recvd)
+std::string UDPClient::queryStats(const std::string& dest, uint16_t port, std::chrono::milliseconds timeout)
 {
-    uint32_t pagesCount = (recvd - 2) / 8;
+    boost::asio::io_context context;
+    udp::socket socket(context, udp::endpoint(udp::v6(), 0));
+    udp::endpoint server(boost::asio::ip::address::from_string(dest), port);
 
-    m_Checksums.resize(pagesCount);
+    Header request{.type = Message::Stats, .session = std::random_device()()};
+    socket.send_to(boost::asio::buffer(&request, sizeof(request)), server);
 
-    memcpy(&m_PageSize, shift, 2);
-    memcpy(m_Checksums.data(), (char*)shift + 2, 8 * pagesCount);
-    m_ChecksumsReceived = true;
+    std::string stats;
+    auto buffer = std::make_unique_for_overwrite<char[]>(MAX_PAGE_SIZE);
+    udp::endpoint sender;
+    socket.async_receive_from(boost::asio::buffer(buffer.get(), MAX_PAGE_SIZE), sender,
+    [&](const boost::system::error_code& error, std::size_t recvd)
+    {
+        Header header;
+        if(error || recvd < sizeof(header))
+            return;
+        memcpy(&header, buffer.get(), sizeof(header));
+        if(header.magic == PROTOCOL_MAGIC && header.type == Message::Stats && header.session == request.session)
+            stats.assign(buffer.get() + sizeof(header), recvd - sizeof(header));
+    });
 
-    m_Response.resize(pagesCount * (m_PageSize / 8));
+    context.run_for(timeout);
+    return stats;
+}
 
-    if(m_ReceivedPages.size() == pagesCount)
-    {
-        pingBack();
-        m_DataReady.test_and_set();
-        m_DataReady.notify_one();
-    }
+void UDPClient::refused(const std::string& msg)
+{
+    m_Log->log(msg);
+    std::cerr << "server: " << msg << std::endl;
+    m_Aborted = true;
+    finish();
+}
+
+void UDPClient::send(Header header, boost::asio::const_buffer payload)
+{
+    header.session = m_Session;
+    m_Socket.send_to(std::array{boost::asio::const_buffer(&header, sizeof(header)), payload}, m_Server);
 }
 
-void UDPClient::processData(double* shift, uint32_t size, uint32_t recvd)
+void UDPClient::processData(const Header& header, const double* values, uint32_t recvd)
 {
-    if(m_ChecksumsReceived)
+    uint32_t count = recvd / sizeof(double);
+    if(recvd == 0)
+        return;
+
+    // damaged page is dropped before it touches anything and asked for again like a lost one
+    Header blank = header;
+    blank.crc = 0;
+    if(crc32c(values, recvd, crc32c(&blank, sizeof(blank))) != header.crc)
     {
-        if(size > m_PageSize)
-        {
-            receive(shift + recvd / 8, size - recvd);
-        }
-        else if(size == m_PageSize)
+        m_Log->log("page " + std::to_string(header.index) + " corrupted", Level::Warning);
+        return;
+    }
+
+    layout(header);
+    if(!m_PerPage || m_Aborted)
+        return;
+
+    // encoded size tells nothing, count of values comes from layout
+    if(header.codec != Codec::Raw)
+    {
+        count = header.index + 1 == m_PagesCount ? m_Tail : m_PerPage;
+        if(!decompress((const std::byte*)values, recvd, header.codec, m_Decoded.get(), count))
         {
-            pingBack();
-            if(recvd != m_PageSize) // means tail smaller than full page
-                m_Response.erase(m_Response.begin() + ((m_Checksums.size() - 1) * m_PageSize + recvd / 8), m_Response.end());
-            m_DataReady.test_and_set();
-            m_DataReady.notify_one();
+            m_Log->log("page " + std::to_string(header.index) + " malformed", Level::Warning);
+            return;
         }
+        values = m_Decoded.get();
     }
-    else
+
+    accept(header.index, values, count);
+}
+
+// every server datagram carries the layout, so the first one which gets through sets it
+void UDPClient::layout(const Header& header)
+{
+    if(m_Aborted || m_PerPage || header.pages == 0 || header.size == 0 || header.tail > header.size)
+        return;
+
+    // tail is cut off when the last page is in; without output the layout stays unknown,
+    // so no page is placed anywhere
+    if(auto error = m_OutFile.create(m_output, (std::size_t)header.pages * header.size))
     {
-        // always keep free at least MAX_PAGE_SIZE free space
-        m_Response.resize(m_Response.size() + recvd / sizeof(double));
-        double* newShift = m_Response.data() + m_ReceivedPages.size() * (recvd / sizeof(double));
-        receive(newShift + recvd / 8, MAX_PAGE_SIZE);
+        m_Log->log(error);
+        std::cerr << "output: " << error.message() << std::endl;
+        m_Aborted = true;
+        m_allDataReached = true;
+        finish();
+        return;
     }
 
-    m_ReceivedPages.emplace(*shift);
+    m_PagesCount = header.pages;
+    m_PerPage = header.size;
+    m_Tail = header.tail;
+    m_Group = header.group;
+    m_Received.assign((m_PagesCount + 63) / 64, 0);
+
+    if(!(m_Request.flags & FLAG_SORTED))
+        m_Runs = std::make_unique_for_overwrite<double[]>((std::size_t)m_PagesCount * m_PerPage);
+    m_Decoded = std::make_unique_for_overwrite<double[]>(m_PerPage);
+
+    if(!m_Group)
+        return;
+
+    uint32_t groups = (m_PagesCount + m_Group - 1) / m_Group;
+    m_Received.resize((m_PagesCount + groups + 63) / 64);
+    m_GroupReceived.assign(groups, 0);
+    m_Recovery = std::make_unique<double[]>((std::size_t)groups * m_PerPage);
 }
 
-void UDPClient::processPing()
+void UDPClient::accept(uint32_t index, const double* values, uint32_t count)
 {
-    std::vector<std::byte> returnBuffer;
-
-    if(m_ChecksumsReceived)
+    if(index < m_PagesCount)
     {
-        if(m_Checksums.size() == m_ReceivedPages.size())
-            pingBack();
-        else
-            returnBuffer = missedPages();
+        if(!place(index, values, count))
+            return;
     }
     else
     {
-        returnBuffer = receivedChecksums();
+        // parity page
+        if(!m_Recovery || index >= m_PagesCount + m_GroupReceived.size() || count > m_PerPage || received(index))
+            return;
+        m_Received[index / 64] |= 1ull << (index % 64);
     }
-    m_Socket.send_to(boost::asio::buffer(returnBuffer.data(), returnBuffer.size()), m_Server);
+
+    if(m_Recovery)
+        absorb(index, values, count);
 }
 
-void UDPClient::pingBack()
+// groups are interleaved, data pages of group g are g, g + groups, g + 2 * groups...
+void UDPClient::absorb(uint32_t index, const double* values, uint32_t count)
 {
-    
-    m_allDataReached = true;
-    uint8_t end;
-    m_Socket.send_to(boost::asio::buffer(&end, 1), m_Server);
+    const uint32_t groups = m_GroupReceived.size();
+    uint32_t group = index < m_PagesCount ? index % groups : index - m_PagesCount;
+    uint32_t size = (m_PagesCount - group + groups - 1) / groups;
+    double* sum = m_Recovery.get() + (std::size_t)group * m_PerPage;
+
+    // members are data pages and parity, nothing to do once only one is missing
+    if(m_GroupReceived[group] >= size)
+        return;
+
+    xorInto(sum, values, count);
+    if(++m_GroupReceived[group] < size)
+        return;
+
+    for(uint32_t missing = group; missing < m_PagesCount; missing += groups)
+        if(!received(missing))
+        {
+            m_Log->log("page " + std::to_string(missing) + " recovered");
+            place(missing, sum, missing + 1 == m_PagesCount ? m_Tail : m_PerPage);
+            break;
+        }
 }
 
-std::vector<std::byte> UDPClient::missedPages()
+bool UDPClient::place(uint32_t index, const double* values, uint32_t count)
 {
-    std::vector<std::byte> returnBuffer;
-    std::vector<uint16_t> idx;
-    for(uint32_t i = 0; i < m_Checksums.size(); ++i)
-        if(!m_ReceivedPages.contains(m_Checksums[i]))
-            idx.push_back(i);
+    if(m_allDataReached || index >= m_PagesCount || count > m_PerPage || received(index))
+        return false;
+
+    m_Received[index / 64] |= 1ull << (index % 64);
+    ++m_ReceivedCount;
 
-    returnBuffer.resize(idx.size() * 2 + 1/*padding*/);
-    memcpy(returnBuffer.data(), idx.data(), idx.size() * 2);
-    return returnBuffer;
+    // server sorted pages already, and page index is its position in output
+    bool sorted = m_Request.flags & FLAG_SORTED;
+    double* slot = (sorted ? m_OutFile.data().data() : m_Runs.get()) + (std::size_t)index * m_PerPage;
+    std::copy_n(values, count, slot);
+    if(!sorted)
+        pushPage({slot, count});
+
+    if(m_ReceivedCount == m_PagesCount)
+    {
+        pingBack();
+        finish();
+    }
+    return true;
 }
 
-std::vector<std::byte> UDPClient::receivedChecksums()
+bool UDPClient::received(uint32_t index) const
 {
-    std::vector<std::byte> returnBuffer;
-    std::vector<double> existedPages(m_ReceivedPages.begin(), m_ReceivedPages.end());
-    returnBuffer.resize(existedPages.size() * sizeof(double) + 2/*padding*/);
-    memcpy(returnBuffer.data(), existedPages.data(), existedPages.size() * sizeof(double));
-    return returnBuffer;
+    return m_Received[index / 64] >> (index % 64) & 1;
+}
+
+void UDPClient::processPing()
+{
+    // layout comes with any server datagram, without it there is nothing to ask for yet
+    if(!m_PerPage)
+        return;
+
+    if(m_ReceivedCount == m_PagesCount)
+        pingBack();
+    else
+        missedPages();
+}
+
+void UDPClient::pingBack()
+{
+    m_allDataReached = true;
+    send({.type = Message::Ack}, boost::asio::const_buffer());
+}
+
+// selective ack: words of the received bitmap from the first one with a missing page to the last one,
+// so a few losses cost a few words; pages which don't fit in a datagram are asked next round
+void UDPClient::missedPages()
+{
+    const uint32_t words = (m_PagesCount + 63) / 64; // parity bits follow data ones
+    auto missing = [&](uint32_t word)
+    {
+        uint64_t bits = ~m_Received[word];
+        if(word + 1 == words && m_PagesCount % 64)
+            bits &= (1ull << m_PagesCount % 64) - 1;
+        return bits;
+    };
+
+    uint32_t first = 0;
+    while(first < words && !missing(first))
+        ++first;
+    uint32_t last = std::min<uint32_t>(words, first + NACK_WORDS);
+    while(last > first && !missing(last - 1))
+        --last;
+
+    if(first == last)
+        return;
+
+    uint32_t index = first * 64;
+    send({.type = Message::Nack, .index = index, .pages = std::min(m_PagesCount, last * 64) - index},
+        boost::asio::buffer(m_Received.data() + first, (last - first) * sizeof(uint64_t)));
 }
\ No newline at end of file
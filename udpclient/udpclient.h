@@ -4,54 +4,113 @@
 #include <atomic>
 #include <boost/asio.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <memory>
-#include <set>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
 #include <thread>
+#include <vector>
+#include "mappedfile.h"
 #include "../common/logger.h"
+#include "../common/protocol.h"
 
 using boost::asio::ip::udp;
 
 inline constexpr uint16_t MAX_PAGE_SIZE = 65'515; // max possible payload
+inline constexpr int      RECEIVE_BUFFER_SIZE = 8 << 20; // server sends pages in batches, kernel caps it by rmem_max
+// words of received bitmap in one Nack
+inline constexpr uint32_t NACK_WORDS = (MAX_PAGE_SIZE - sizeof(Header)) / sizeof(uint64_t);
+// no datagram for that long while pages are missing means server's end ping was lost, lost pages are asked anyway
+inline constexpr auto     IDLE_TIMEOUT = std::chrono::milliseconds(200);
 
 class UDPClient
 {
-    double                 m_Seed;
-    std::vector<double>    m_Response;
-    
-    std::vector<double>    m_Checksums;
-    std::set<double>       m_ReceivedPages;
-    uint16_t               m_PageSize;
-    bool                   m_ChecksumsReceived = false;
+    Request                m_Request;
+    uint32_t               m_Session;           // random, server datagrams of other sessions are dropped
+    std::unique_ptr<double[]>   m_Incoming; // datagram buffer
+    // pages and End of multicast round come to the group under its session, everything else as usual
+    uint32_t               m_GroupSession = 0;  // 0 until subscribed
+    std::unique_ptr<double[]>   m_GroupIncoming;
+    MappedFile             m_OutFile;
+
+    // every page is copied to its final offset right away: sorted pages to the output file,
+    // others to m_Runs, where worker sorts them for the merge
+    uint32_t               m_PagesCount = 0;
+    uint32_t               m_PerPage = 0;       // values in every page but the last, 0 until known
+    uint32_t               m_Tail = 0;          // values in the last page
+    std::vector<uint64_t>  m_Received;          // bitmap of page indexes, parity pages included
+    uint32_t               m_ReceivedCount = 0; // data pages only
+    std::unique_ptr<double[]>   m_Runs;
+    std::unique_ptr<double[]>   m_Decoded;  // compressed page, before it is placed
+
+    // FEC: XOR of every member of an interleaved group as it arrived, which is the missing
+    // data page once all other members (parity included) are in
+    uint32_t               m_Group = 0;
+    std::unique_ptr<double[]>   m_Recovery;
+    std::vector<uint32_t>  m_GroupReceived;
+
+    uint32_t               m_Datagrams = 0;     // seen by idle timer
     bool                   m_allDataReached = false;
+    std::atomic<bool>      m_Aborted = false;   // refused by server or no output
+
+    // pages handed over to worker, which sorts them while the rest is still arriving
+    std::mutex                              m_PagesLock;
+    std::condition_variable                 m_PagesArrived;
+    std::deque<std::span<double>>           m_Pages;
+    bool                                    m_Finished = false;
+    std::chrono::steady_clock::time_point   m_LastPage;
 
-    std::atomic_flag       m_DataReady;
     std::jthread           m_Worker;
     std::string            m_output;
 
     boost::asio::io_context     m_Context;
     udp::socket                 m_Socket;
     udp::endpoint               m_Server;
+    udp::socket                 m_GroupSocket;
+    udp::endpoint               m_GroupSender;
     boost::asio::steady_timer   m_Delay;
+    boost::asio::steady_timer   m_Idle;
 
     std::shared_ptr<Logger>     m_Log;                      
 
     private:
-        void receive(double* shift, uint32_t size);
+        // buffer and sender belong to the socket, both sockets may have a datagram ready at once
+        void receive(udp::socket& socket, double* buffer, udp::endpoint& sender);
         void pushSeed();
         void sortAndWrite();
+        void pushPage(std::span<double> page);
+        void finish();
+        void watchIdle(uint32_t datagrams);
 
         // helpers
         void processPing();
         void pingBack();
-        std::vector<std::byte> missedPages();
-        std::vector<std::byte> receivedChecksums();
-        void processChecksums(double* shift, uint32_t size, uint32_t recvd);
-        void processData(double* shift, uint32_t size, uint32_t recvd);
+        void missedPages();
+        void refused(const std::string& msg);
+        void send(Header header, boost::asio::const_buffer payload);
+        void processData(const Header& header, const double* values, uint32_t recvd);
+        void subscribe(const Subscription& subscription);
+        void layout(const Header& header);
+        void accept(uint32_t index, const double* values, uint32_t count);
+        bool place(uint32_t index, const double* values, uint32_t count);
+        void absorb(uint32_t index, const double* values, uint32_t count);
+        bool received(uint32_t index) const;
 
     public:
-        UDPClient(double seed, std::string dest, uint16_t port, std::string output);
+        // sorted: server sorts dataset, client only puts pages in order;
+        // nonce: (seed, nonce) determine the dataset, the server may serve it from its cache;
+        // multicast: such dataset may come through a multicast group shared with other clients
+        UDPClient(double seed, std::string dest, uint16_t port, std::string output, bool sorted = false,
+            std::optional<uint64_t> nonce = std::nullopt, bool multicast = false);
         void waitUntilEnd();
+
+        // server stats as JSON text, empty when no answer comes in time
+        static std::string queryStats(const std::string& dest, uint16_t port, std::chrono::milliseconds timeout = std::chrono::seconds(1));
 };
 
 #endif // UDP_SERVER_UDP_CLIENT_H
\ No newline at end of file
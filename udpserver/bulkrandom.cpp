@@ -0,0 +1,196 @@
+#include "bulkrandom.h"
+#include <cassert>
+#include <cstring>
+#include <immintrin.h>
+
+namespace
+{
+
+// Philox4x32 constants (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+constexpr uint32_t M0 = 0xD2511F53;
+constexpr uint32_t M1 = 0xCD9E8D57;
+constexpr uint32_t W0 = 0x9E3779B9;
+constexpr uint32_t W1 = 0xBB67AE85;
+constexpr uint32_t rounds = 10;
+
+constexpr uint64_t lower32 = 0xFFFFFFFF;
+constexpr uint64_t exponentOfOne = 0x3FF0000000000000; // bit pattern of 1.0
+
+// 52 high bits go to mantissa of [1, 2), shifted down to [0, 1)
+double toUnit(uint64_t bits)
+{
+    uint64_t value = (bits >> 12) | exponentOfOne;
+    double unit;
+    memcpy(&unit, &value, sizeof(unit));
+    return unit - 1.;
+}
+
+void fillScalar(const uint32_t key[2], uint64_t counter, double* out, uint32_t pairs, double low, double span)
+{
+    for(uint32_t n = 0; n < pairs; ++n, ++counter)
+    {
+        uint32_t c0 = counter, c1 = counter >> 32, c2 = 0, c3 = 0;
+        uint32_t k0 = key[0], k1 = key[1];
+
+        for(uint32_t r = 0; r < rounds; ++r)
+        {
+            uint64_t p0 = (uint64_t)M0 * c0;
+            uint64_t p1 = (uint64_t)M1 * c2;
+            c0 = (p1 >> 32) ^ c1 ^ k0;
+            c1 = p1;
+            c2 = (p0 >> 32) ^ c3 ^ k1;
+            c3 = p0;
+            k0 += W0;
+            k1 += W1;
+        }
+
+        // built with -ffp-contract=off, no kernel fuses multiply and add, so all of them are bit-identical
+        out[2 * n] = low + toUnit((uint64_t)c1 << 32 | c0) * span;
+        out[2 * n + 1] = low + toUnit((uint64_t)c3 << 32 | c2) * span;
+    }
+}
+
+// every 64 bit lane holds one 32 bit word of the counter, so mul_epu32 gives full product
+__attribute__((target("avx2")))
+void fillAvx2(const uint32_t key[2], uint64_t counter, double* out, uint32_t pairs, double low, double span)
+{
+    const __m256i m0 = _mm256_set1_epi64x(M0);
+    const __m256i m1 = _mm256_set1_epi64x(M1);
+    const __m256i mask = _mm256_set1_epi64x(lower32);
+    const __m256i exponent = _mm256_set1_epi64x(exponentOfOne);
+    const __m256i lanes = _mm256_setr_epi64x(0, 1, 2, 3);
+    const __m256d one = _mm256_set1_pd(1.);
+    const __m256d vlow = _mm256_set1_pd(low);
+    const __m256d vspan = _mm256_set1_pd(span);
+
+    uint32_t n = 0;
+    for(; n + 4 <= pairs; n += 4, counter += 4)
+    {
+        __m256i ctr = _mm256_add_epi64(_mm256_set1_epi64x(counter), lanes);
+        __m256i c0 = _mm256_and_si256(ctr, mask);
+        __m256i c1 = _mm256_srli_epi64(ctr, 32);
+        __m256i c2 = _mm256_setzero_si256();
+        __m256i c3 = _mm256_setzero_si256();
+        uint32_t k0 = key[0], k1 = key[1];
+
+        for(uint32_t r = 0; r < rounds; ++r)
+        {
+            __m256i p0 = _mm256_mul_epu32(c0, m0);
+            __m256i p1 = _mm256_mul_epu32(c2, m1);
+            c0 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p1, 32), c1), _mm256_set1_epi64x(k0));
+            c1 = _mm256_and_si256(p1, mask);
+            c2 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p0, 32), c3), _mm256_set1_epi64x(k1));
+            c3 = _mm256_and_si256(p0, mask);
+            k0 += W0;
+            k1 += W1;
+        }
+
+        __m256i first = _mm256_or_si256(_mm256_slli_epi64(c1, 32), c0);
+        __m256i second = _mm256_or_si256(_mm256_slli_epi64(c3, 32), c2);
+
+        __m256d a = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(first, 12), exponent)), one);
+        __m256d b = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(second, 12), exponent)), one);
+        a = _mm256_add_pd(vlow, _mm256_mul_pd(a, vspan));
+        b = _mm256_add_pd(vlow, _mm256_mul_pd(b, vspan));
+
+        // interleave to a0 b0 a1 b1 | a2 b2 a3 b3, same order as scalar
+        __m256d lo = _mm256_unpacklo_pd(a, b);
+        __m256d hi = _mm256_unpackhi_pd(a, b);
+        _mm256_storeu_pd(out + 2 * n, _mm256_permute2f128_pd(lo, hi, 0x20));
+        _mm256_storeu_pd(out + 2 * n + 4, _mm256_permute2f128_pd(lo, hi, 0x31));
+    }
+
+    fillScalar(key, counter, out + 2 * n, pairs - n, low, span);
+}
+
+__attribute__((target("avx512f")))
+void fillAvx512(const uint32_t key[2], uint64_t counter, double* out, uint32_t pairs, double low, double span)
+{
+    const __m512i m0 = _mm512_set1_epi64(M0);
+    const __m512i m1 = _mm512_set1_epi64(M1);
+    const __m512i mask = _mm512_set1_epi64(lower32);
+    const __m512i exponent = _mm512_set1_epi64(exponentOfOne);
+    const __m512i lanes = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m512i firstHalf = _mm512_setr_epi64(0, 8, 1, 9, 2, 10, 3, 11);
+    const __m512i secondHalf = _mm512_setr_epi64(4, 12, 5, 13, 6, 14, 7, 15);
+    const __m512d one = _mm512_set1_pd(1.);
+    const __m512d vlow = _mm512_set1_pd(low);
+    const __m512d vspan = _mm512_set1_pd(span);
+
+    uint32_t n = 0;
+    for(; n + 8 <= pairs; n += 8, counter += 8)
+    {
+        __m512i ctr = _mm512_add_epi64(_mm512_set1_epi64(counter), lanes);
+        __m512i c0 = _mm512_and_si512(ctr, mask);
+        __m512i c1 = _mm512_srli_epi64(ctr, 32);
+        __m512i c2 = _mm512_setzero_si512();
+        __m512i c3 = _mm512_setzero_si512();
+        uint32_t k0 = key[0], k1 = key[1];
+
+        for(uint32_t r = 0; r < rounds; ++r)
+        {
+            __m512i p0 = _mm512_mul_epu32(c0, m0);
+            __m512i p1 = _mm512_mul_epu32(c2, m1);
+            c0 = _mm512_xor_si512(_mm512_xor_si512(_mm512_srli_epi64(p1, 32), c1), _mm512_set1_epi64(k0));
+            c1 = _mm512_and_si512(p1, mask);
+            c2 = _mm512_xor_si512(_mm512_xor_si512(_mm512_srli_epi64(p0, 32), c3), _mm512_set1_epi64(k1));
+            c3 = _mm512_and_si512(p0, mask);
+            k0 += W0;
+            k1 += W1;
+        }
+
+        __m512i first = _mm512_or_si512(_mm512_slli_epi64(c1, 32), c0);
+        __m512i second = _mm512_or_si512(_mm512_slli_epi64(c3, 32), c2);
+
+        __m512d a = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(_mm512_srli_epi64(first, 12), exponent)), one);
+        __m512d b = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(_mm512_srli_epi64(second, 12), exponent)), one);
+        a = _mm512_add_pd(vlow, _mm512_mul_pd(a, vspan));
+        b = _mm512_add_pd(vlow, _mm512_mul_pd(b, vspan));
+
+        _mm512_storeu_pd(out + 2 * n, _mm512_permutex2var_pd(a, firstHalf, b));
+        _mm512_storeu_pd(out + 2 * n + 8, _mm512_permutex2var_pd(a, secondHalf, b));
+    }
+
+    fillScalar(key, counter, out + 2 * n, pairs - n, low, span);
+}
+
+} // namespace
+
+SimdLevel detectSimd()
+{
+    static const SimdLevel level = []()
+    {
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f"))
+            return SimdLevel::Avx512;
+        if(__builtin_cpu_supports("avx2"))
+            return SimdLevel::Avx2;
+        return SimdLevel::Scalar;
+    }();
+
+    return level;
+}
+
+BulkRandom::BulkRandom(double low, double high, uint64_t key, SimdLevel level)
+    : m_Key{(uint32_t)key, (uint32_t)(key >> 32)}
+    , m_Low(low)
+    , m_Span(high - low)
+    , m_Level(level)
+{
+
+}
+
+void BulkRandom::fill(double* out, uint32_t count)
+{
+    assert(count % 2 == 0);
+    uint32_t pairs = count / 2;
+
+    switch(m_Level)
+    {
+        case SimdLevel::Avx512: fillAvx512(m_Key, m_Counter, out, pairs, m_Low, m_Span); break;
+        case SimdLevel::Avx2:   fillAvx2(m_Key, m_Counter, out, pairs, m_Low, m_Span); break;
+        default:                fillScalar(m_Key, m_Counter, out, pairs, m_Low, m_Span); break;
+    }
+
+    m_Counter += pairs;
+}
@@ -0,0 +1,38 @@
+#ifndef UDP_SERVER_BULK_RANDOM_H
+#define UDP_SERVER_BULK_RANDOM_H
+
+#include <cstdint>
+
+enum class SimdLevel { Scalar, Avx2, Avx512 };
+
+// best kernel supported by the running CPU
+SimdLevel detectSimd();
+
+/*
+ * Counter-based generator of uniform doubles in [low, high).
+ * Every counter value is encrypted by Philox4x32-10 under the key, 128 output
+ * bits give two doubles with 52 random mantissa bits each. There is no state
+ * except the counter, so blocks are independent and filled by SIMD kernels
+ * (AVX2: 4 counters per step, AVX-512: 8). All kernels produce bit-identical
+ * output, so a (key, counter) pair determines the values on any CPU.
+*/
+class BulkRandom
+{
+    uint32_t    m_Key[2];
+    uint64_t    m_Counter = 0;
+    double      m_Low;
+    double      m_Span;
+    SimdLevel   m_Level;
+
+    public:
+        BulkRandom(double low, double high, uint64_t key, SimdLevel level = detectSimd());
+
+        // count must be even, every counter gives two values
+        void fill(double* out, uint32_t count);
+
+        uint64_t counter() const { return m_Counter; }
+        void seek(uint64_t counter) { m_Counter = counter; }
+        SimdLevel level() const { return m_Level; }
+};
+
+#endif // UDP_SERVER_BULK_RANDOM_H
\ No newline at end of file
@@ -1,9 +1,84 @@
 #ifndef UDP_SERVER_CONFIG_H
 #define UDP_SERVER_CONFIG_H
 
+#include <chrono>
 #include <cstdint>
+#include <string>
 
+// datagram sizes, page header included
 inline constexpr uint16_t PAGE_SIZE = 64000;
+// page fitting single ethernet frame (ipv6 header included), used with UDP GSO
+inline constexpr uint16_t GSO_PAGE_SIZE = 1448;
 inline constexpr uint32_t GENERATOR_THRESHOLD = 1'000'000;
+// doubles generated for one instance per pass of generator thread, must be even
+inline constexpr uint32_t GENERATION_BATCH = 256;
+
+// max datagrams handed to the kernel by single sendmmsg call
+inline constexpr uint32_t TRANSMIT_BATCH = 32;
+// kernel limits for single UDP_SEGMENT send
+inline constexpr uint32_t GSO_MAX_SEGMENTS = 64;
+inline constexpr uint32_t GSO_MAX_PAYLOAD = 65'507;
+
+// pacing, all rates in bytes per second
+// starting (and max) rate of single destination, lowered on every NACK
+inline constexpr double PACING_FLOW_RATE = 2e9;
+inline constexpr double PACING_MIN_RATE = 1e6;
+// cap for all destinations together
+inline constexpr double PACING_GLOBAL_RATE = 4e9;
+// bucket depth, max burst which may leave without pause, must fit client receive buffer;
+// that one is capped by net.core.rmem_max (~208 KiB on stock kernels), a deeper burst
+// overruns it on the first round of every dataset, before any NACK comes back
+inline constexpr double PACING_BURST = 192 << 10;
+// destinations without traffic for this long forget their rate
+inline constexpr std::chrono::seconds PACING_IDLE_TIMEOUT{30};
+
+// datasets finished by generator and not yet picked up by network thread
+inline constexpr uint32_t HANDOFF_CAPACITY = 1024;
+
+// default cap on memory mapped by storage pool (tables being filled and values of live sessions), MiB
+inline constexpr uint32_t STORAGE_MEMORY_LIMIT = 4096;
+// default share of it kept by finished deterministic datasets for repeated requests, MiB
+inline constexpr uint32_t DATASET_CACHE_LIMIT = 256;
+
+// multicast round of a dataset starts that long after its first subscriber, requests published
+// meanwhile join it and subscribers have time to join the group
+inline constexpr std::chrono::milliseconds MULTICAST_DELAY{20};
+
+// sessions waiting for client confirmation, each one pins whole dataset in memory
+inline constexpr uint32_t SESSION_LIMIT = 1024;
+inline constexpr std::chrono::seconds SESSION_TIMEOUT{60};
+
+// runtime settings, read from config json
+struct Settings
+{
+    uint16_t port;
+    // pages of GSO_PAGE_SIZE, contiguous runs of them are segmented by the kernel
+    bool     gso = false;
+    // data pages covered by one XOR parity page sent after them, 0 disables FEC
+    uint32_t fec = 0;
+    // pages packed by byte shuffle codec (common/codec.h), fewer bytes for bandwidth limited links
+    bool     compress = false;
+    // group address, pages of deterministic datasets go there once for all clients asking with FLAG_MULTICAST,
+    // empty disables multicast
+    std::string multicast = {};
+    // port of the group, 0 means port + 1
+    uint16_t multicastPort = 0;
+    // pacing bucket depth in KiB, may grow together with rmem_max of clients
+    uint32_t pacingBurst = PACING_BURST / 1024;
+    // sockets sharing the port, each with own network thread
+    uint32_t shards = 1;
+    // storage pool cap in MiB, requests over it are refused with "server busy"
+    uint32_t memoryLimit = STORAGE_MEMORY_LIMIT;
+    // deterministic datasets (FLAG_DETERMINISTIC) kept for repeated requests, MiB of memoryLimit, 0 keeps none
+    uint32_t cacheLimit = DATASET_CACHE_LIMIT;
+    // advise transparent huge pages for storage pool blocks
+    bool     hugePages = false;
+    // every request generated by all generator threads together, lowers latency of single request
+    bool     split = false;
+    // stats are written to the log every that many seconds, 0 leaves them to Stats queries only
+    uint32_t statsInterval = 0;
+    // lowest level written to server.log: debug, info, warning or error
+    std::string logLevel = "info";
+};
 
 #endif // UDP_SERVER_CONFIG_H
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "datasetcache.h"
+#include <cstring>
+#include <utility>
+
+namespace
+{
+
+uint64_t mix(uint64_t x)
+{
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+uint64_t bitsOf(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+} // namespace
+
+uint64_t DatasetKey::generatorKey() const
+{
+    return mix(mix(bitsOf(seed)) ^ nonce);
+}
+
+bool DatasetKey::operator==(const DatasetKey& other) const
+{
+    return bitsOf(seed) == bitsOf(other.seed) && nonce == other.nonce && sorted == other.sorted;
+}
+
+std::size_t DatasetKeyHash::operator()(const DatasetKey& key) const noexcept
+{
+    return mix(key.generatorKey() ^ key.sorted);
+}
+
+DatasetCache::DatasetCache(uint32_t limit)
+    : m_Limit(limit)
+{
+
+}
+
+DatasetCache::Lookup DatasetCache::join(const DatasetKey& key, Callback ready, CStorage& storage)
+{
+    std::lock_guard _(m_Mutex);
+    auto [iter, inserted] = m_Entries.try_emplace(key);
+    auto& entry = iter->second;
+
+    if(entry.storage)
+    {
+        m_Recent.splice(m_Recent.begin(), m_Recent, entry.position);
+        storage = entry.storage;
+        return Lookup::Cached;
+    }
+
+    entry.waiters.push_back(std::move(ready));
+    return inserted ? Lookup::Missing : Lookup::Pending;
+}
+
+void DatasetCache::complete(const DatasetKey& key, CStorage storage)
+{
+    std::vector<Callback> waiters;
+    CStorage evicted;
+    {
+        std::lock_guard _(m_Mutex);
+        auto iter = m_Entries.find(key);
+        if(iter == m_Entries.end())
+            return;
+
+        waiters = std::move(iter->second.waiters);
+
+        if(!storage || m_Limit == 0)
+            m_Entries.erase(iter);
+        else
+        {
+            iter->second.storage = storage;
+            iter->second.position = m_Recent.insert(m_Recent.begin(), key);
+
+            if(m_Recent.size() > m_Limit)
+                evicted = dropOldest();
+        }
+    }
+
+    for(auto& ready : waiters)
+        ready(storage);
+}
+
+CStorage DatasetCache::dropOldest()
+{
+    auto oldest = m_Entries.find(m_Recent.back());
+    CStorage storage = std::move(oldest->second.storage);
+    m_Entries.erase(oldest);
+    m_Recent.pop_back();
+    return storage;
+}
+
+bool DatasetCache::evict()
+{
+    CStorage evicted;   // destroyed after the lock is released
+    std::lock_guard _(m_Mutex);
+    if(m_Recent.empty())
+        return false;
+
+    evicted = dropOldest();
+    return true;
+}
+
+uint32_t DatasetCache::size()
+{
+    std::lock_guard _(m_Mutex);
+    return m_Recent.size();
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef UDP_SERVER_DATASET_CACHE_H
+#define UDP_SERVER_DATASET_CACHE_H
+
+#include "datastorage.h"
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// everything a deterministic dataset depends on
+struct DatasetKey
+{
+    double      seed;
+    uint64_t    nonce;
+    bool        sorted;
+
+    // key of the random generator, sorted and unsorted datasets hold the same values
+    uint64_t generatorKey() const;
+    bool operator==(const DatasetKey& other) const;
+};
+
+struct DatasetKeyHash
+{
+    std::size_t operator()(const DatasetKey& key) const noexcept;
+};
+
+/*
+ * Finished deterministic datasets, least recently used one is dropped over the limit.
+ * Identical requests arriving while their dataset is generated wait for the same job
+ * instead of starting their own. Only values are kept: pages carry session of the client,
+ * so every request paginates them again. A cached dataset pins its pool block,
+ * evict() hands one back when the pool runs dry. Thread safe, callbacks run outside the lock.
+*/
+class DatasetCache
+{
+    using Callback = std::function<void(CStorage)>;
+
+    struct Entry
+    {
+        CStorage                            storage;    // nullptr while generated
+        std::vector<Callback>               waiters;
+        std::list<DatasetKey>::iterator     position;   // in m_Recent once finished
+    };
+
+    std::mutex                                                  m_Mutex;
+    std::unordered_map<DatasetKey, Entry, DatasetKeyHash>       m_Entries;
+    std::list<DatasetKey>                                       m_Recent;   // finished ones, most recent first
+    uint32_t                                                    m_Limit;
+
+    private:
+        // caller holds the lock and drops the result after releasing it,
+        // the last reference hands the block back to the pool
+        CStorage dropOldest();
+
+    public:
+        // limit in datasets, 0 keeps nothing but still joins identical requests in flight
+        explicit DatasetCache(uint32_t limit);
+
+        enum class Lookup
+        {
+            Cached,     // storage is set, ready is dropped
+            Pending,    // ready waits for the job in flight
+            Missing,    // ready waits too, caller starts the job and passes its dataset to complete()
+        };
+
+        Lookup join(const DatasetKey& key, Callback ready, CStorage& storage);
+
+        // hands dataset over to every waiter and caches it, nullptr when generation failed
+        void complete(const DatasetKey& key, CStorage storage);
+
+        // drops the least recently used finished dataset, false when there is none
+        bool evict();
+
+        uint32_t size();
+};
+
+#endif // UDP_SERVER_DATASET_CACHE_H
\ No newline at end of file
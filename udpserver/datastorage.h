@@ -2,10 +2,15 @@
 #define UDP_SERVER_DATA_STORAGE_H
 
 #include "config.h"
-#include <cstdint>
+#include "../common/radixsort.h"
+#include <algorithm>
 #include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <emmintrin.h>
 #include <memory>
-#include <vector>
+#include <span>
 
 // compile time analog to std::bit_ceil();
 constexpr uint32_t bit_ceil(uint32_t n) noexcept
@@ -32,78 +37,192 @@ class DataStorage
     static constexpr float    loadFactor = 0.5;
     static constexpr uint64_t numOfDoubles = GENERATOR_THRESHOLD;
     static constexpr uint64_t sizeOfHashtable = bit_ceil((uint64_t)(numOfDoubles / loadFactor));
-    static constexpr uint32_t sizeMinusOne = sizeOfHashtable - 1;
-    static constexpr uint32_t tombstone = sizeOfHashtable + 1;
+    static constexpr uint32_t groupSize = 16; // control bytes compared by single SSE2 instruction
+    static constexpr uint32_t numOfGroups = sizeOfHashtable / groupSize;
+    static constexpr uint8_t  empty = 0x80;
+    static constexpr uint32_t prefetchDistance = 8; // values hashed and prefetched ahead of insertion
+    static constexpr uint32_t maxPartitions = 64;
 
-    // array-of-structures -> structure-of-arrays optimization
-    Storage                                m_Storage;
-    std::array<uint32_t, sizeOfHashtable>  m_Offsets;
-    std::array<uint32_t, sizeOfHashtable>  m_Nexts;
+    // disjoint range of groups and of the value array, filled by single thread without locking
+    struct alignas(64) Partition
+    {
+        uint32_t    firstGroup;
+        uint32_t    groups;
+        uint32_t    begin;
+        uint32_t    counter;    // next free offset in the value array
+        uint32_t    end;
+    };
 
-    std::vector<std::pair</*offset*/uint32_t, /*next or tombstone*/uint32_t>>  m_Collisions;
-    
-    uint32_t    m_counter = 0;
+    // open addressing with linear probing over groups of slots,
+    // control byte keeps 7 bit fingerprint of the value (or empty marker), slot keeps its offset,
+    // so whole group is checked by one compare and values are read only on fingerprint match
+    Storage                                             m_Storage;
+    alignas(64) std::array<uint8_t, sizeOfHashtable>    m_Control;
+    alignas(64) std::array<uint32_t, sizeOfHashtable>   m_Slots;
+
+    std::array<Partition, maxPartitions>                m_Partitions;
+    uint32_t                                            m_NumOfPartitions = 1;
 
     private:
         void init()
         {
-            m_Offsets.fill(tombstone);
-            m_Nexts.fill(tombstone);
+            m_Control.fill(empty);
+            partition(1);
+        }
+
+        static uint64_t hash(double value)
+        {
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return bits * 0x9E3779B97F4A7C15; // fibonacci hashing, high bits select group
+        }
+
+        static uint32_t groupOf(const Partition& part, uint64_t hash)
+        {
+            return part.firstGroup + ((hash >> 32) * part.groups >> 32);
+        }
+
+        bool insert(double value, uint64_t hash, Partition& part)
+        {
+            uint8_t fingerprint = (hash >> 25) & 0x7F;
+            __m128i needle = _mm_set1_epi8(fingerprint);
+
+            for(uint32_t group = groupOf(part, hash); ; group = group + 1 == part.firstGroup + part.groups ? part.firstGroup : group + 1)
+            {
+                uint32_t base = group * groupSize;
+                __m128i control = _mm_load_si128(reinterpret_cast<const __m128i*>(m_Control.data() + base));
+
+                for(uint32_t matches = _mm_movemask_epi8(_mm_cmpeq_epi8(control, needle)); matches; matches &= matches - 1)
+                {
+                    if((*m_Storage)[m_Slots[base + std::countr_zero(matches)]] == value) // value already exist
+                        return false;
+                }
+
+                // nothing is ever erased, so value can't lie behind the first free slot
+                if(uint32_t free = _mm_movemask_epi8(control)) [[likely]]
+                {
+                    uint32_t pos = base + std::countr_zero(free);
+                    m_Control[pos] = fingerprint;
+                    m_Slots[pos] = part.counter;
+                    (*m_Storage)[part.counter] = value;
+                    ++part.counter;
+                    return true;
+                }
+            }
         }
 
     public:
         DataStorage()
+            : DataStorage(std::make_shared<std::array<double, GENERATOR_THRESHOLD>>())
+        {
+
+        }
+
+        explicit DataStorage(Storage values)
+            : m_Storage(std::move(values))
         {
-            m_Storage = std::make_shared<std::array<double, GENERATOR_THRESHOLD>>();
             init();
         }
 
-        bool insert(double value)
+        // empty table over another value array, used to recycle storage
+        void reset(Storage values)
         {
-            if(m_counter == numOfDoubles) return false;
-            uint32_t pos = *reinterpret_cast<uint64_t*>(&value) & sizeMinusOne;
-            if(m_Offsets[pos] == tombstone) [[likely]]
-            {
-                m_Offsets[pos] = m_counter;
-                (*m_Storage)[m_counter] = value;
-                ++m_counter;
-                return true;
-            }
-            else if((*m_Storage)[m_Offsets[pos]] == value) // value already exist
+            m_Storage = std::move(values);
+            init();
+        }
+
+        // drops reference to values, storage is unusable until reset
+        void release()
+        {
+            m_Storage.reset();
+        }
+
+        // splits empty storage into count parts (at most maxPartitions), each one with own share of groups
+        // and values, so different threads may fill different parts at once, caller keeps values of parts distinct
+        void partition(uint32_t count)
+        {
+            count = std::clamp(count, 1u, maxPartitions);
+            for(uint32_t p = 0; p < count; ++p)
             {
-                return false;
+                auto& part = m_Partitions[p];
+                part.firstGroup = numOfGroups * p / count;
+                part.groups = numOfGroups * (p + 1) / count - part.firstGroup;
+                part.begin = part.counter = numOfDoubles * p / count;
+                part.end = numOfDoubles * (p + 1) / count;
             }
-            else if(m_Nexts[pos] == tombstone)
+            m_NumOfPartitions = count;
+        }
+
+        bool insert(double value)
+        {
+            auto& part = m_Partitions[0];
+            if(part.counter == part.end) return false;
+            return insert(value, hash(value), part);
+        }
+
+        // hashes values prefetchDistance ahead and prefetches their groups, so cache misses of different values overlap,
+        // returns number of inserted (unique) values
+        uint32_t insertBatch(std::span<const double> values, uint32_t partition = 0)
+        {
+            auto& part = m_Partitions[partition];
+            std::array<uint64_t, prefetchDistance> hashes;
+            uint32_t inserted = 0;
+
+            auto prefetch = [&](std::size_t i)
             {
-                (*m_Storage)[m_counter] = value;
-                m_Nexts[pos] = m_Collisions.size();
-                m_Collisions.push_back({m_counter, tombstone});
-                ++m_counter;
-                return true;
-            }
-            else [[unlikely]]
+                uint64_t& h = hashes[i % prefetchDistance];
+                h = hash(values[i]);
+                uint32_t base = groupOf(part, h) * groupSize;
+                __builtin_prefetch(m_Control.data() + base, 1);
+                __builtin_prefetch(m_Slots.data() + base, 1);
+            };
+
+            for(std::size_t i = 0; i < std::min<std::size_t>(prefetchDistance, values.size()); ++i)
+                prefetch(i);
+
+            for(std::size_t i = 0; i < values.size() && part.counter < part.end; ++i)
             {
-                // walking throw collision sequence
-                pos = m_Nexts[pos];
-                while(m_Collisions[pos].second != tombstone)
-                {
-                    if((*m_Storage)[m_Collisions[pos].first] == value)
-                        return false;
-                    else
-                        pos = m_Collisions[pos].second;
-                }
-                (*m_Storage)[m_counter] = value;
-                m_Collisions[pos].second = m_Collisions.size();
-                m_Collisions.push_back({m_counter, tombstone});
-                ++m_counter;
-                return true;
+                uint64_t h = hashes[i % prefetchDistance];
+                if(i + prefetchDistance < values.size())
+                    prefetch(i + prefetchDistance);
+                inserted += insert(values[i], h, part);
             }
 
+            return inserted;
+        }
+
+        // sorts values of full storage descending, hash table serves as scratch memory,
+        // so the storage is good only for reading until reset
+        void sortDescending(uint32_t threads = 1)
+        {
+            static_assert(sizeof(m_Slots) >= sizeof(double) * numOfDoubles);
+            std::span<double> values(m_Storage->data(), size());
+            radixSortDescending(values, std::span<double>(reinterpret_cast<double*>(m_Slots.data()), values.size()), threads);
+        }
+
+        bool full(uint32_t partition) const
+        {
+            return m_Partitions[partition].counter == m_Partitions[partition].end;
+        }
+
+        // control byte of every slot, 7 bit fingerprint or empty marker (high bit), in groups
+        // of 16 probed at once; read only, for measuring probe sequences (benchmarks/storage_bench)
+        std::span<const uint8_t> control() const
+        {
+            return m_Control;
+        }
+
+        uint32_t partitions() const
+        {
+            return m_NumOfPartitions;
         }
 
         uint32_t size() const
         {
-            return m_counter;
+            uint32_t size = 0;
+            for(uint32_t p = 0; p < m_NumOfPartitions; ++p)
+                size += m_Partitions[p].counter - m_Partitions[p].begin;
+            return size;
         }
 
         const double* data() const
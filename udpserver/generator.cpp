@@ -1,92 +1,223 @@
 #include "generator.h"
+#include "bulkrandom.h"
 #include "datastorage.h"
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <deque>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <random>
 #include <thread>
+#include <vector>
 #include "config.h"
 
+// shared by all parts of a request
+struct GenerationRequest
+{
+    SubmitCallback                          ready;
+    std::atomic<uint32_t>                   remaining;  // parts not finished yet
+    uint32_t                                sortThreads; // 0 means unsorted delivery
+
+    GenerationRequest(SubmitCallback ready, uint32_t parts, uint32_t sortThreads)
+        : ready(std::move(ready))
+        , remaining(parts)
+        , sortThreads(sortThreads)
+    {
+
+    }
+};
+
+// whole request, or one part of it in its own range of values and partition of storage
 struct AssociatedInfo
 {
-    std::uniform_real_distribution<double>  spawn;
+    BulkRandom                              spawn;
     std::shared_ptr<DataStorage>            storage;
     Timestamp                               timestamp;
-    SubmitCallback                          ready;
+    std::shared_ptr<GenerationRequest>      request;
+    uint32_t                                partition;
 };
 
 struct Job
 {
-    std::vector<AssociatedInfo>         instances;
+    std::deque<AssociatedInfo>          instances; // waiting ones, oldest first
     std::mutex                          mutex;
-    std::mt19937                        engine = std::mt19937(std::random_device{}());
+    std::atomic<uint32_t>               running = 0;
+    std::random_device                  device;
+    std::array<double, GENERATION_BATCH> batch;
 
-    void addNewInstance(double seed, SubmitCallback ready)
+    void addNewInstance(double low, double high, std::shared_ptr<DataStorage> storage, std::shared_ptr<GenerationRequest> request,
+        uint32_t partition, Timestamp timestamp, std::optional<uint64_t> key = std::nullopt)
     {
         std::lock_guard _(mutex);
 
         instances.push_back
         ({
-            std::uniform_real_distribution<double>(-seed, seed),
-            std::make_shared<DataStorage>(),
-            std::chrono::steady_clock::now(),
-            std::move(ready)
+            BulkRandom(low, high, key.value_or((uint64_t)device() << 32 | device())),
+            std::move(storage),
+            timestamp,
+            std::move(request),
+            partition
         });
     }
 
     uint32_t getPayload()
+    {
+        std::lock_guard _(mutex);
+        return instances.size() + running;
+    }
+
+    uint32_t waiting()
     {
         std::lock_guard _(mutex);
         return instances.size();
     }
+
+    std::optional<Timestamp> oldest()
+    {
+        std::lock_guard _(mutex);
+        if(instances.empty())
+            return std::nullopt;
+        return instances.front().timestamp;
+    }
+
+    std::optional<AssociatedInfo> take()
+    {
+        std::lock_guard _(mutex);
+        if(instances.empty())
+            return std::nullopt;
+
+        auto instance = std::move(instances.front());
+        instances.pop_front();
+        return instance;
+    }
+
+    void generate(AssociatedInfo& instance, const std::atomic<bool>& stop, Stats* stats)
+    {
+        auto& storage = *instance.storage;
+        uint64_t duplicates = 0;
+
+        while(!storage.full(instance.partition))
+        {
+            if(stop) [[unlikely]]
+                return;
+            instance.spawn.fill(batch.data(), batch.size());
+            uint32_t inserted = storage.insertBatch(batch, instance.partition);
+            // the batch which fills the partition is left uncounted, its tail is never looked at
+            if(!storage.full(instance.partition))
+                duplicates += batch.size() - inserted;
+        }
+
+        if(stats)
+            stats->add(Counter::Duplicates, duplicates);
+
+        // the last finished part hands dataset over, acq_rel makes values of other parts visible
+        if(--instance.request->remaining != 0)
+            return;
+
+        if(instance.request->sortThreads)
+            storage.sortDescending(instance.request->sortThreads);
+
+        instance.request->ready(storage.getUnderlying());
+    }
 };
 
-Generator::Generator(uint32_t numOfThreads)
+// earliest deadline first: oldest waiting instance across all jobs, own queue wins ties
+static std::optional<AssociatedInfo> nextInstance(const std::vector<Job*>& jobs)
+{
+    Job* victim = nullptr;
+    Timestamp deadline = Timestamp::max();
+
+    for(auto job : jobs)
+    {
+        auto oldest = job->oldest();
+        if(oldest && *oldest < deadline)
+        {
+            deadline = *oldest;
+            victim = job;
+        }
+    }
+
+    // may be taken by another job meanwhile, then caller just looks again
+    return victim ? victim->take() : std::nullopt;
+}
+
+Generator::Generator(uint32_t numOfThreads, StoragePool& pool, bool split, Stats* stats)
+    : m_Pool(pool)
+    , m_Stats(stats)
+    , m_Split(split)
 {
     for(uint32_t i = 0; i < numOfThreads; ++i)
+        m_Jobs.push_back(std::make_unique<Job>());
+
+    for(uint32_t i = 0; i < numOfThreads; ++i)
+        m_Threads.emplace_back([this, i]() { run(i); });
+}
+
+Generator::~Generator()
+{
+    m_Stop = true;
+    ++m_Arrivals;
+    m_Arrivals.notify_all();
+    m_Threads.clear(); // joins, requests not finished yet are dropped
+}
+
+void Generator::run(uint32_t index)
+{
+    // own job first, the rest are stolen from when they hold older requests
+    std::vector<Job*> jobs;
+    for(uint32_t i = 0; i < m_Jobs.size(); ++i)
+        jobs.push_back(m_Jobs[(index + i) % m_Jobs.size()].get());
+
+    auto& job = *jobs.front();
+
+    while(!m_Stop)
     {
-        m_Jobs.push_back(std::make_shared<Job>());
-        std::thread([](std::weak_ptr<Job> wjob)
+        uint32_t arrivals = m_Arrivals.load();
+
+        auto instance = nextInstance(jobs);
+        if(!instance)
         {
-            Timestamp oldest;
-
-            while(auto job = wjob.lock())
-            {
-                std::lock_guard _(job->mutex);
-                for(auto iter = job->instances.begin(); iter != job->instances.end();)
-                {
-                    auto& instance = *iter;
-
-                    if (oldest.time_since_epoch().count() == 0 || instance.timestamp < oldest)
-                        oldest = instance.timestamp;
-
-                    uint32_t num = 10; // TODO use info about timestamp to increase payload to oldest instances
-                    
-                    for(uint32_t i = 0; i < num; ++i)
-                        instance.storage->insert(instance.spawn(job->engine));
-
-                    if(instance.storage->size() >= GENERATOR_THRESHOLD)
-                    {
-                        if(oldest == instance.timestamp)
-                            oldest = Timestamp();
-
-                        instance.ready(instance.storage->getUnderlying());
-
-                        iter = job->instances.erase(iter);
-                    }
-                    else
-                    {
-                        ++iter;
-                    }
-
-                }
-            }
-        }, m_Jobs.back()).detach();
+            // parks on futex, request added after the load above wakes it right away
+            m_Arrivals.wait(arrivals);
+            continue;
+        }
+
+        // generated to the end, everything arriving meanwhile is younger
+        ++job.running;
+        job.generate(*instance, m_Stop, m_Stats);
+        --job.running;
     }
 }
 
-void Generator::addNewInstance(double seed, SubmitCallback ready)
+bool Generator::addNewInstance(double seed, SubmitCallback ready, bool sorted, std::optional<uint64_t> key)
 {
+    auto storage = m_Pool.acquire();
+    if(!storage)
+        return false;
+
+    auto timestamp = std::chrono::steady_clock::now();
+
+    // parts depend on number of threads, deterministic dataset is filled by one of them whatever it is
+    if(m_Split && m_Jobs.size() > 1 && !key)
+    {
+        // every job gets equal slice of [-seed, seed] and partition of storage,
+        // slices are disjoint, so values stay unique without any locking between jobs
+        storage->partition(m_Jobs.size());
+        uint32_t parts = storage->partitions();
+        // latency mode, the last part sorts with all threads too
+        auto request = std::make_shared<GenerationRequest>(std::move(ready), parts, sorted ? m_Jobs.size() : 0);
+        auto bound = [=](uint32_t p) { return -seed + 2 * seed * p / parts; };
+
+        for(uint32_t p = 0; p < parts; ++p)
+            m_Jobs[p % m_Jobs.size()]->addNewInstance(bound(p), bound(p + 1), storage, request, p, timestamp);
+
+        m_Arrivals += parts;
+        m_Arrivals.notify_all();
+        return true;
+    }
+
     uint32_t min = 0;
     uint32_t minPayload = m_Jobs[min]->getPayload();
     for(uint32_t i = 1; i < m_Jobs.size(); ++i)
@@ -99,5 +230,17 @@ void Generator::addNewInstance(double seed, SubmitCallback ready)
         }
     }
 
-    m_Jobs[min]->addNewInstance(seed, std::move(ready));
+    m_Jobs[min]->addNewInstance(-seed, seed, std::move(storage), std::make_shared<GenerationRequest>(std::move(ready), 1, sorted ? 1 : 0), 0, timestamp, key);
+
+    ++m_Arrivals;
+    m_Arrivals.notify_one();
+    return true;
+}
+
+uint32_t Generator::waiting() const
+{
+    uint32_t waiting = 0;
+    for(const auto& job : m_Jobs)
+        waiting += job->waiting();
+    return waiting;
 }
@@ -2,24 +2,54 @@
 #define UDP_SERVER_GENERATOR_H
 
 #include "datastorage.h"
+#include "stats.h"
+#include "storagepool.h"
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
 
 using SubmitCallback = std::function<void(CStorage)>;
 using Timestamp      = std::chrono::time_point<std::chrono::steady_clock>;
 
 struct Job;
 
+/*
+ * Pool of threads filling DataStorage for requests.
+ * Every thread owns a Job, a queue of waiting requests, but takes the oldest request
+ * of all queues. Threads without work park on a futex and are woken by the next request.
+ * In split mode every request is cut into one part per thread, each part fills its own
+ * slice of the range into its own partition of storage, so single request uses all cores.
+*/
 class Generator
 {
-    std::vector<std::shared_ptr<Job>>      m_Jobs;
+    std::vector<std::unique_ptr<Job>>      m_Jobs;
+    StoragePool&                           m_Pool;
+    Stats*                                 m_Stats;   // may be nullptr
+    bool                                   m_Split;   // every request filled by all threads together
+    std::atomic<uint32_t>                  m_Arrivals = 0; // bumped on every request, threads park on it
+    std::atomic<bool>                      m_Stop = false;
+    std::vector<std::jthread>              m_Threads;
+
+    private:
+        void run(uint32_t index);
 
     public:
-        Generator(uint32_t numOfThreads);
+        Generator(uint32_t numOfThreads, StoragePool& pool, bool split = false, Stats* stats = nullptr);
+        ~Generator();
     
-        void addNewInstance(double seed, SubmitCallback ready);
+        // false when pool has no memory left for another dataset,
+        // sorted dataset is ordered descending before handed to callback;
+        // with key the dataset is determined by (seed, key) alone, such request is never split,
+        // otherwise the key is random
+        bool addNewInstance(double seed, SubmitCallback ready, bool sorted = false, std::optional<uint64_t> key = std::nullopt);
+
+        // requests no thread has started yet
+        uint32_t waiting() const;
 };
 
 #endif // UDP_SERVER_GENERATOR_H
\ No newline at end of file
@@ -0,0 +1,144 @@
+#ifndef UDP_SERVER_HANDOFF_H
+#define UDP_SERVER_HANDOFF_H
+
+#include "config.h"
+#include <array>
+#include <atomic>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/system/error_code.hpp>
+#include <cstdint>
+#include <functional>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+
+// bounded lock-free multi-producer single-consumer ring (Vyukov's sequence per cell scheme)
+template<typename T, uint32_t Capacity>
+class MpscRing
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be power of two");
+    static constexpr uint64_t mask = Capacity - 1;
+
+    struct Cell
+    {
+        std::atomic<uint64_t>   sequence;
+        T                       value;
+    };
+
+    std::array<Cell, Capacity>              m_Cells;
+    alignas(64) std::atomic<uint64_t>       m_Tail = 0; // shared by producers
+    alignas(64) uint64_t                    m_Head = 0; // owned by consumer
+
+    public:
+        MpscRing()
+        {
+            for(uint64_t i = 0; i < Capacity; ++i)
+                m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        // any thread, false when full, value is untouched in such case
+        bool push(T& value)
+        {
+            uint64_t pos = m_Tail.load(std::memory_order_relaxed);
+
+            while(true)
+            {
+                Cell& cell = m_Cells[pos & mask];
+                int64_t diff = (int64_t)cell.sequence.load(std::memory_order_acquire) - (int64_t)pos;
+
+                if(diff == 0)
+                {
+                    if(m_Tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        cell.value = std::move(value);
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if(diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = m_Tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // consumer thread only
+        bool pop(T& value)
+        {
+            Cell& cell = m_Cells[m_Head & mask];
+
+            if(cell.sequence.load(std::memory_order_acquire) != m_Head + 1)
+                return false;
+
+            value = std::move(cell.value);
+            cell.value = T{}; // don't pin resources of consumed item
+            cell.sequence.store(m_Head + Capacity, std::memory_order_release);
+            ++m_Head;
+            return true;
+        }
+};
+
+/*
+ * Hands items produced on foreign threads over to the thread running io_context.
+ * Producers only touch the ring and an eventfd, never a mutex; the io thread
+ * is woken by the eventfd and drains everything published so far.
+*/
+template<typename T, uint32_t Capacity = HANDOFF_CAPACITY>
+class Handoff
+{
+    MpscRing<T, Capacity>                   m_Ring;
+    boost::asio::posix::stream_descriptor   m_Event;
+    std::function<void(T)>                  m_Handler;
+
+    private:
+        void wait()
+        {
+            m_Event.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+                [this](const boost::system::error_code& error)
+                {
+                    if(error)
+                        return;
+
+                    uint64_t count;
+                    [[maybe_unused]] auto _ = ::read(m_Event.native_handle(), &count, sizeof(count));
+
+                    T value;
+                    while(m_Ring.pop(value))
+                        m_Handler(std::move(value));
+
+                    wait();
+                });
+        }
+
+    public:
+        Handoff(boost::asio::io_context& context)
+            : m_Event(context, ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+        {
+
+        }
+
+        // must be called before io_context runs or from its thread
+        void start(std::function<void(T)> handler)
+        {
+            m_Handler = std::move(handler);
+            wait();
+        }
+
+        // any thread
+        void push(T value)
+        {
+            // ring is full only if io thread is stalled, generator may wait for it
+            while(!m_Ring.push(value))
+                std::this_thread::yield();
+
+            uint64_t one = 1;
+            [[maybe_unused]] auto _ = ::write(m_Event.native_handle(), &one, sizeof(one));
+        }
+};
+
+#endif // UDP_SERVER_HANDOFF_H
\ No newline at end of file
@@ -25,8 +25,49 @@ int main(int argc, char *argv[])
     // verify config
     if(!config_json["port"].is_number_unsigned())
         throw std::runtime_error("seed must be unsigned value");
+    if(config_json.contains("gso") && !config_json["gso"].is_boolean())
+        throw std::runtime_error("gso must be boolean value");
+    if(config_json.contains("fec") && !config_json["fec"].is_number_unsigned())
+        throw std::runtime_error("fec must be unsigned value");
+    if(config_json.contains("compress") && !config_json["compress"].is_boolean())
+        throw std::runtime_error("compress must be boolean value");
+    if(config_json.contains("multicast") && !config_json["multicast"].is_string())
+        throw std::runtime_error("multicast must be string value");
+    if(config_json.contains("multicastPort") && !config_json["multicastPort"].is_number_unsigned())
+        throw std::runtime_error("multicastPort must be unsigned value");
+    if(config_json.contains("pacingBurst") && !(config_json["pacingBurst"].is_number_unsigned() && config_json["pacingBurst"] > 0))
+        throw std::runtime_error("pacingBurst must be positive value");
+    if(config_json.contains("shards") && !(config_json["shards"].is_number_unsigned() && config_json["shards"] > 0))
+        throw std::runtime_error("shards must be positive value");
+    if(config_json.contains("memoryLimit") && !(config_json["memoryLimit"].is_number_unsigned() && config_json["memoryLimit"] > 0))
+        throw std::runtime_error("memoryLimit must be positive value");
+    if(config_json.contains("cacheLimit") && !config_json["cacheLimit"].is_number_unsigned())
+        throw std::runtime_error("cacheLimit must be unsigned value");
+    if(config_json.contains("hugePages") && !config_json["hugePages"].is_boolean())
+        throw std::runtime_error("hugePages must be boolean value");
+    if(config_json.contains("split") && !config_json["split"].is_boolean())
+        throw std::runtime_error("split must be boolean value");
+    if(config_json.contains("statsInterval") && !config_json["statsInterval"].is_number_unsigned())
+        throw std::runtime_error("statsInterval must be unsigned value");
+    if(config_json.contains("logLevel") && !(config_json["logLevel"].is_string() && parseLevel(config_json["logLevel"].get<std::string>())))
+        throw std::runtime_error("logLevel must be one of debug, info, warning, error");
 
-    Server server(config_json["port"]);
+    Settings settings{config_json["port"]};
+    settings.gso = config_json.value("gso", settings.gso);
+    settings.fec = config_json.value("fec", settings.fec);
+    settings.compress = config_json.value("compress", settings.compress);
+    settings.multicast = config_json.value("multicast", settings.multicast);
+    settings.multicastPort = config_json.value("multicastPort", settings.multicastPort);
+    settings.pacingBurst = config_json.value("pacingBurst", settings.pacingBurst);
+    settings.shards = config_json.value("shards", settings.shards);
+    settings.memoryLimit = config_json.value("memoryLimit", settings.memoryLimit);
+    settings.cacheLimit = config_json.value("cacheLimit", settings.cacheLimit);
+    settings.hugePages = config_json.value("hugePages", settings.hugePages);
+    settings.split = config_json.value("split", settings.split);
+    settings.statsInterval = config_json.value("statsInterval", settings.statsInterval);
+    settings.logLevel = config_json.value("logLevel", settings.logLevel);
+
+    Server server(settings);
     server.runLoop();
 
     return 0;
@@ -0,0 +1,136 @@
+#include "sessiontable.h"
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <optional>
+
+namespace
+{
+
+uint64_t mix(uint64_t x)
+{
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+} // namespace
+
+std::size_t EndpointHash::operator()(const udp::endpoint& endpoint) const noexcept
+{
+    uint64_t hash = endpoint.port();
+
+    if(endpoint.address().is_v6())
+    {
+        auto bytes = endpoint.address().to_v6().to_bytes();
+        uint64_t halves[2];
+        memcpy(halves, bytes.data(), sizeof(halves));
+        hash = mix(hash ^ halves[0]);
+        hash = mix(hash ^ halves[1]);
+    }
+    else
+    {
+        hash = mix(hash ^ ((uint64_t)endpoint.address().to_v4().to_uint() << 16));
+    }
+
+    return hash;
+}
+
+SessionTable::SessionTable(uint32_t limit)
+    : m_Limit(limit)
+{
+
+}
+
+SessionTable::Shard& SessionTable::shardOf(const udp::endpoint& endpoint)
+{
+    // high bits, unordered_map inside the shard consumes the low ones
+    return m_Shards[(EndpointHash{}(endpoint) >> 32) % numOfShards];
+}
+
+void SessionTable::insert(std::shared_ptr<SubmitInfo> info)
+{
+    auto now = Clock::now().time_since_epoch().count();
+    auto& shard = shardOf(*info->dst());
+    {
+        std::unique_lock _(shard.mutex);
+        auto [iter, inserted] = shard.sessions.try_emplace(*info->dst(), info, now);
+
+        if(!inserted)
+        {
+            iter->second.info = std::move(info);
+            iter->second.touched = now;
+            return;
+        }
+    }
+
+    if(++m_Size > m_Limit)
+        evictOldest();
+}
+
+std::shared_ptr<SubmitInfo> SessionTable::find(const udp::endpoint& endpoint)
+{
+    auto& shard = shardOf(endpoint);
+    std::shared_lock _(shard.mutex);
+
+    auto iter = shard.sessions.find(endpoint);
+    if(iter == shard.sessions.end())
+        return nullptr;
+
+    iter->second.touched = Clock::now().time_since_epoch().count();
+    return iter->second.info;
+}
+
+bool SessionTable::erase(const udp::endpoint& endpoint)
+{
+    auto& shard = shardOf(endpoint);
+    std::unique_lock _(shard.mutex);
+
+    if(shard.sessions.erase(endpoint) == 0)
+        return false;
+
+    --m_Size;
+    return true;
+}
+
+uint32_t SessionTable::expire(Clock::duration timeout)
+{
+    auto deadline = (Clock::now() - timeout).time_since_epoch().count();
+    uint32_t expired = 0;
+
+    for(auto& shard : m_Shards)
+    {
+        std::unique_lock _(shard.mutex);
+        expired += std::erase_if(shard.sessions, [=](const auto& item) { return item.second.touched < deadline; });
+    }
+
+    m_Size -= expired;
+    return expired;
+}
+
+void SessionTable::evictOldest()
+{
+    // rare path, only when client flood exceeds the limit
+    std::optional<udp::endpoint> oldest;
+    auto touched = std::numeric_limits<Clock::rep>::max();
+
+    for(auto& shard : m_Shards)
+    {
+        std::shared_lock _(shard.mutex);
+        for(const auto& [endpoint, session] : shard.sessions)
+        {
+            if(session.touched < touched)
+            {
+                touched = session.touched;
+                oldest = endpoint;
+            }
+        }
+    }
+
+    if(oldest)
+        erase(*oldest);
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef UDP_SERVER_SESSION_TABLE_H
+#define UDP_SERVER_SESSION_TABLE_H
+
+#include "config.h"
+#include "submitinfo.h"
+#include <array>
+#include <atomic>
+#include <boost/asio/ip/udp.hpp>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+
+using boost::asio::ip::udp;
+
+struct EndpointHash
+{
+    std::size_t operator()(const udp::endpoint& endpoint) const noexcept;
+};
+
+/*
+ * Sessions waiting for client confirmation, keyed by client endpoint value.
+ * Table is split into independently locked shards, so lookups from different
+ * network threads rarely meet on the same mutex. Size is bounded by SESSION_LIMIT:
+ * when full, the least recently used session is evicted; sessions idle longer
+ * than SESSION_TIMEOUT are dropped by expire().
+*/
+class SessionTable
+{
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr uint32_t numOfShards = 64;
+
+    struct Session
+    {
+        std::shared_ptr<SubmitInfo>     info;
+        std::atomic<Clock::rep>         touched; // updated under shared lock
+
+        Session(std::shared_ptr<SubmitInfo> info, Clock::rep touched)
+            : info(std::move(info))
+            , touched(touched)
+        {
+
+        }
+    };
+
+    struct Shard
+    {
+        std::shared_mutex                                           mutex;
+        std::unordered_map<udp::endpoint, Session, EndpointHash>    sessions;
+    };
+
+    std::array<Shard, numOfShards>  m_Shards;
+    std::atomic<uint32_t>           m_Size = 0;
+    uint32_t                        m_Limit;
+
+    private:
+        Shard& shardOf(const udp::endpoint& endpoint);
+        void evictOldest();
+
+    public:
+        SessionTable(uint32_t limit = SESSION_LIMIT);
+
+        // replaces session of the same endpoint if any
+        void insert(std::shared_ptr<SubmitInfo> info);
+        std::shared_ptr<SubmitInfo> find(const udp::endpoint& endpoint);
+        bool erase(const udp::endpoint& endpoint);
+        uint32_t expire(Clock::duration timeout = SESSION_TIMEOUT);
+
+        uint32_t size() const { return m_Size; }
+};
+
+#endif // UDP_SERVER_SESSION_TABLE_H
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "stats.h"
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <nlohmann/json.hpp>
+#include <utility>
+#include <vector>
+
+uint32_t Histogram::bucket(uint64_t micros)
+{
+    if(micros < (1u << subBits))
+        return micros;
+
+    uint32_t exponent = std::bit_width(micros) - 1;
+    if(exponent >= maxExponent)
+        return buckets - 1;
+
+    // leading bit picks the row, the next subBits the column
+    return ((exponent - subBits + 1) << subBits) | ((micros >> (exponent - subBits)) & ((1u << subBits) - 1));
+}
+
+uint64_t Histogram::upper(uint32_t bucket)
+{
+    uint32_t row = bucket >> subBits;
+    uint64_t column = bucket & ((1u << subBits) - 1);
+    if(row == 0)
+        return column;
+
+    uint32_t shift = row - 1;
+    return ((((1ull << subBits) | column) + 1) << shift) - 1;
+}
+
+uint64_t Histogram::percentile(const Counts& counts, double share)
+{
+    uint64_t total = 0;
+    for(auto count : counts)
+        total += count;
+    if(total == 0)
+        return 0;
+
+    uint64_t rank = std::max<uint64_t>(1, share * total + 0.5), seen = 0;
+    for(uint32_t b = 0; b < buckets; ++b)
+        if((seen += counts[b]) >= rank)
+            return upper(b);
+    return upper(buckets - 1);
+}
+
+namespace
+{
+
+std::atomic<uint64_t> instances = 0;
+
+} // namespace
+
+Stats::Stats()
+    : m_Id(++instances)
+{
+
+}
+
+Stats::Slot& Stats::slot()
+{
+    // (instance, slot index) pairs of this thread, the oldest is forgotten past cacheSize
+    // and the thread then gets a fresh slot of that instance, which is only less spread
+    static constexpr std::size_t cacheSize = 8;
+    thread_local std::vector<std::pair<uint64_t, uint32_t>> indices;
+
+    for(auto [id, index] : indices)
+        if(id == m_Id)
+            return m_Slots[index];
+
+    if(indices.size() == cacheSize)
+        indices.erase(indices.begin());
+    uint32_t index = m_NextSlot.fetch_add(1, std::memory_order_relaxed) % slots;
+    indices.emplace_back(m_Id, index);
+    return m_Slots[index];
+}
+
+void Stats::add(Counter counter, uint64_t count)
+{
+    slot().counters[(std::size_t)counter].fetch_add(count, std::memory_order_relaxed);
+}
+
+void Stats::record(Stage stage, Clock::time_point accepted)
+{
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - accepted).count();
+    slot().stages[(std::size_t)stage][Histogram::bucket(std::max<int64_t>(0, micros))].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t Stats::counter(Counter counter) const
+{
+    uint64_t sum = 0;
+    for(const auto& slot : m_Slots)
+        sum += slot.counters[(std::size_t)counter].load(std::memory_order_relaxed);
+    return sum;
+}
+
+Histogram::Counts Stats::histogram(Stage stage) const
+{
+    Histogram::Counts counts{};
+    for(const auto& slot : m_Slots)
+        for(uint32_t b = 0; b < Histogram::buckets; ++b)
+            counts[b] += slot.stages[(std::size_t)stage][b].load(std::memory_order_relaxed);
+    return counts;
+}
+
+std::string Stats::json(const std::initializer_list<std::pair<const char*, uint64_t>>& gauges) const
+{
+    static constexpr const char* counters[] = {"requests", "refused", "cacheHits", "duplicates", "pagesSent",
+        "pagesResent", "nacks", "acks", "expired"};
+    static constexpr const char* stages[] = {"generated", "firstPage", "lastPage", "acked"};
+    static_assert(std::size(counters) == (std::size_t)Counter::Count && std::size(stages) == (std::size_t)Stage::Count);
+
+    nlohmann::json out;
+    out["uptime"] = std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - m_Started).count();
+
+    for(std::size_t c = 0; c < std::size(counters); ++c)
+        out["counters"][counters[c]] = counter((Counter)c);
+
+    for(auto& [name, value] : gauges)
+        out["gauges"][name] = value;
+
+    for(std::size_t s = 0; s < std::size(stages); ++s)
+    {
+        auto counts = histogram((Stage)s);
+        auto& stage = out["latency_us"][stages[s]];
+        uint64_t total = 0;
+        for(auto count : counts)
+            total += count;
+        stage["count"] = total;
+        stage["p50"] = Histogram::percentile(counts, 0.5);
+        stage["p90"] = Histogram::percentile(counts, 0.9);
+        stage["p99"] = Histogram::percentile(counts, 0.99);
+        stage["max"] = Histogram::percentile(counts, 1);
+    }
+
+    return out.dump();
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef UDP_SERVER_STATS_H
+#define UDP_SERVER_STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// latencies from request accept
+enum class Stage : uint8_t
+{
+    Generated,  // dataset handed over by generator (cache hits included)
+    FirstPage,  // first page handed to the kernel
+    LastPage,   // End after the last page handed to the kernel
+    Acked,      // client confirmed the whole dataset
+    Count
+};
+
+enum class Counter : uint8_t
+{
+    Requests,
+    Refused,
+    CacheHits,
+    Duplicates,     // generated values already in storage
+    PagesSent,
+    PagesResent,
+    Nacks,
+    Acks,
+    Expired,
+    Count
+};
+
+/*
+ * Log-linear histogram of microseconds, HDR style: every power of two is cut into 16 buckets,
+ * so a value is kept within ~6% from 1 us up to ~12 days (longer ones go to the last bucket).
+*/
+class Histogram
+{
+    static constexpr uint32_t subBits = 4;
+    static constexpr uint32_t maxExponent = 40;
+
+    public:
+        static constexpr uint32_t buckets = (maxExponent - subBits + 1) << subBits;
+
+        using Counts = std::array<uint64_t, buckets>;
+
+        static uint32_t bucket(uint64_t micros);
+        // upper bound of values in the bucket
+        static uint64_t upper(uint32_t bucket);
+        // value under which given share of recorded ones lies, 0 when empty
+        static uint64_t percentile(const Counts& counts, double share);
+};
+
+/*
+ * Counters and latency histograms of the server. Every thread records into its own slot of
+ * relaxed atomics, picked once per thread and instance, so the hot path takes no lock and rarely
+ * shares a cache line; readers sum the slots up. A slot may be shared by threads past 16,
+ * which stays correct, only slower.
+*/
+class Stats
+{
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr uint32_t slots = 16;
+
+    struct alignas(64) Slot
+    {
+        std::array<std::atomic<uint64_t>, (std::size_t)Counter::Count>                     counters{};
+        std::array<std::array<std::atomic<uint64_t>, Histogram::buckets>, (std::size_t)Stage::Count> stages{};
+    };
+
+    std::array<Slot, slots>     m_Slots;
+    std::atomic<uint32_t>       m_NextSlot = 0;
+    uint64_t                    m_Id;       // tells instances apart in per-thread slot caches
+    Clock::time_point           m_Started = Clock::now();
+
+    private:
+        Slot& slot();
+
+    public:
+        Stats();
+
+        void add(Counter counter, uint64_t count = 1);
+        void record(Stage stage, Clock::time_point accepted);
+
+        uint64_t counter(Counter counter) const;
+        Histogram::Counts histogram(Stage stage) const;
+
+        // counters, percentiles of every stage (us) and given gauges as one JSON object
+        std::string json(const std::initializer_list<std::pair<const char*, uint64_t>>& gauges = {}) const;
+};
+
+#endif // UDP_SERVER_STATS_H
\ No newline at end of file
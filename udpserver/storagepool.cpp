@@ -0,0 +1,164 @@
+#include "storagepool.h"
+#include <new>
+#include <sys/mman.h>
+
+namespace
+{
+
+constexpr std::size_t pageSize = 4096;
+constexpr std::size_t hugePageSize = 2 << 20;
+
+constexpr std::size_t roundUp(std::size_t size, std::size_t granularity)
+{
+    return (size + granularity - 1) / granularity * granularity;
+}
+
+// touch every page now, so inserts never stop on page fault
+void prefault(void* block, std::size_t size)
+{
+    for(std::size_t offset = 0; offset < size; offset += pageSize)
+        static_cast<volatile char*>(block)[offset] = 0;
+}
+
+} // namespace
+
+StoragePool::Blocks::Blocks(uint64_t limit, bool hugePages)
+    : limit(limit)
+    , hugePages(hugePages)
+    , tableSize(roundUp(sizeof(DataStorage), hugePages ? hugePageSize : pageSize))
+    , valuesSize(roundUp(sizeof(Values), hugePages ? hugePageSize : pageSize))
+{
+
+}
+
+StoragePool::Blocks::~Blocks()
+{
+    for(auto table : tables)
+    {
+        table->~DataStorage();
+        unmap(table, tableSize);
+    }
+
+    for(auto block : values)
+        unmap(block, valuesSize);
+}
+
+void* StoragePool::Blocks::map(std::size_t size)
+{
+    // idle blocks of the other kind give their memory away
+    while(mapped + size > limit)
+    {
+        if(!tables.empty())
+        {
+            tables.back()->~DataStorage();
+            unmap(tables.back(), tableSize);
+            tables.pop_back();
+        }
+        else if(!values.empty())
+        {
+            unmap(values.back(), valuesSize);
+            values.pop_back();
+        }
+        else
+        {
+            return nullptr;
+        }
+    }
+
+    void* block = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(block == MAP_FAILED)
+        return nullptr;
+
+    // best effort, ignored when transparent huge pages are disabled
+    if(hugePages)
+        madvise(block, size, MADV_HUGEPAGE);
+
+    prefault(block, size);
+    mapped += size;
+    return block;
+}
+
+void StoragePool::Blocks::unmap(void* block, std::size_t size)
+{
+    munmap(block, size);
+    mapped -= size;
+}
+
+void StoragePool::Blocks::putBack(DataStorage* table)
+{
+    std::lock_guard _(mutex);
+    tables.push_back(table);
+}
+
+void StoragePool::Blocks::putBack(Values* block)
+{
+    std::lock_guard _(mutex);
+    values.push_back(block);
+}
+
+StoragePool::StoragePool(uint64_t limit, bool hugePages, uint32_t prealloc)
+    : m_Blocks(std::make_shared<Blocks>(limit, hugePages))
+{
+    std::vector<std::shared_ptr<DataStorage>> warm;
+    for(uint32_t i = 0; i < prealloc; ++i)
+        if(auto storage = acquire())
+            warm.push_back(std::move(storage));
+}
+
+std::shared_ptr<DataStorage> StoragePool::acquire()
+{
+    auto& blocks = *m_Blocks;
+    Values* values = nullptr;
+    DataStorage* table = nullptr;
+    void* fresh = nullptr;
+
+    {
+        std::lock_guard _(blocks.mutex);
+
+        if(!blocks.values.empty())
+        {
+            values = blocks.values.back();
+            blocks.values.pop_back();
+        }
+        else if(void* block = blocks.map(blocks.valuesSize))
+        {
+            values = new (block) Values;
+        }
+        else
+        {
+            return nullptr;
+        }
+
+        if(!blocks.tables.empty())
+        {
+            table = blocks.tables.back();
+            blocks.tables.pop_back();
+        }
+        else if(!(fresh = blocks.map(blocks.tableSize)))
+        {
+            blocks.values.push_back(values);
+            return nullptr;
+        }
+    }
+
+    // deleters keep blocks alive, so storage may outlive the pool
+    Storage storage(values, [owner = m_Blocks](Values* values) { owner->putBack(values); });
+
+    if(fresh)
+        table = new (fresh) DataStorage(std::move(storage));
+    else
+        table->reset(std::move(storage));
+
+    return std::shared_ptr<DataStorage>(table, [owner = m_Blocks](DataStorage* table)
+    {
+        // values stay alive as long as somebody holds CStorage
+        table->release();
+        owner->putBack(table);
+    });
+}
+
+uint64_t StoragePool::mapped() const
+{
+    std::lock_guard _(m_Blocks->mutex);
+    return m_Blocks->mapped;
+}
@@ -0,0 +1,57 @@
+#ifndef UDP_SERVER_STORAGE_POOL_H
+#define UDP_SERVER_STORAGE_POOL_H
+
+#include "datastorage.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+ * Recycles hash tables and value arrays of DataStorage instead of allocating ~18MB per request.
+ * Blocks are mapped once, prefaulted (optionally advised to transparent huge pages) and come back
+ * to the pool when the last reference drops: the table once generation is finished,
+ * the values once the last CStorage (session, queued pages) is gone.
+ * Mapped memory never exceeds the limit, acquire returns nullptr instead.
+ * Thread safe, references may be dropped on any thread and may outlive the pool.
+*/
+class StoragePool
+{
+    using Values = std::array<double, GENERATOR_THRESHOLD>;
+
+    // shared with deleters of handed out references
+    struct Blocks
+    {
+        std::mutex                  mutex;
+        std::vector<DataStorage*>   tables;
+        std::vector<Values*>        values;
+        uint64_t                    limit;
+        uint64_t                    mapped = 0;
+        bool                        hugePages;
+        std::size_t                 tableSize;
+        std::size_t                 valuesSize;
+
+        Blocks(uint64_t limit, bool hugePages);
+        ~Blocks();
+
+        // nullptr when limit is reached and nothing idle can be unmapped
+        void* map(std::size_t size);
+        void unmap(void* block, std::size_t size);
+        void putBack(DataStorage* table);
+        void putBack(Values* values);
+    };
+
+    std::shared_ptr<Blocks> m_Blocks;
+
+    public:
+        // limit in bytes, prealloc storages are mapped and prefaulted right away
+        StoragePool(uint64_t limit, bool hugePages = false, uint32_t prealloc = 0);
+
+        // empty storage ready for insertion, or nullptr when memory limit is reached
+        std::shared_ptr<DataStorage> acquire();
+
+        uint64_t mapped() const;
+};
+
+#endif // UDP_SERVER_STORAGE_POOL_H
\ No newline at end of file
@@ -1,48 +1,137 @@
 #include "submitinfo.h"
 #include "config.h"
+#include "../common/codec.h"
+#include "../common/crc32c.h"
+#include "../common/parity.h"
 #include <cmath>
+#include <cstring>
 
-SubmitInfo::SubmitInfo(CStorage storage, std::shared_ptr<udp::endpoint> dst)
+SubmitInfo::SubmitInfo(CStorage storage, std::shared_ptr<udp::endpoint> dst, uint16_t pageSize, uint32_t fecGroup, uint32_t session, Codec codec,
+    std::chrono::steady_clock::time_point accepted)
     : m_Storage(std::move(storage))
+    , m_PageSize(pageSize - sizeof(Header))
+    , m_Group(fecGroup)
+    , m_Codec(codec)
+    , m_Session(session)
     , m_Destination(std::move(dst))
+    , m_Accepted(accepted)
 { 
     paginate();
+    genParity();
+    pack();
     genChecksums();
 }
 
+SubmitInfo::SubmitInfo(std::shared_ptr<const SubmitInfo> round, std::shared_ptr<udp::endpoint> dst, uint32_t session,
+    std::chrono::steady_clock::time_point accepted)
+    : m_Storage(round->m_Storage)
+    , m_PageSize(round->m_PageSize)
+    , m_Group(round->m_Group)
+    , m_Codec(round->m_Codec)
+    , m_Session(session)
+    , m_Destination(std::move(dst))
+    , m_Accepted(accepted)
+    , m_Round(std::move(round))
+{
+
+}
+
+const_buffer SubmitInfo::page(uint32_t index) const
+{
+    if(m_Round)
+        return m_Round->page(index);
+    if(!m_Encoded.empty())
+        return m_Encoded[index];
+    if(index < m_Pages.size())
+        return m_Pages[index];
+    return const_buffer(m_Parity.data() + (index - m_Pages.size()) * (m_PageSize / sizeof(double)), m_PageSize);
+}
+
 void SubmitInfo::paginate()
 {
     const double* data = m_Storage->data();
-    uint32_t size = PAGE_SIZE;
+    uint32_t size = m_PageSize;
     uint32_t totalSize = m_Storage->size() * sizeof(double);
-    uint32_t loadedSize = PAGE_SIZE;
+    uint32_t loadedSize = m_PageSize;
 
-    std::generate_n(std::back_inserter(m_Pages), ceil(totalSize / (float)PAGE_SIZE), [&]()
+    std::generate_n(std::back_inserter(m_Pages), ceil(totalSize / (float)m_PageSize), [&]()
     {
         auto res = const_buffer(data, size);
-        size = std::min((uint32_t)PAGE_SIZE, totalSize - loadedSize);
-        data += PAGE_SIZE / 8;
+        size = std::min((uint32_t)m_PageSize, totalSize - loadedSize);
+        data += m_PageSize / 8;
         loadedSize += size;
         return res;
     });
+
+    // sent in front of page from separate buffer, so pages are never copied
+    uint32_t pages = m_Pages.size();
+    uint32_t groups = m_Group ? (pages + m_Group - 1) / m_Group : 0;
+    m_End = {.type = Message::End, .session = m_Session, .pages = pages, .size = (uint16_t)(m_PageSize / sizeof(double)),
+        .tail = (uint16_t)(pages ? m_Pages.back().size() / sizeof(double) : 0), .group = m_Group};
+    m_Headers.assign(pages + groups, m_End);
+    for(uint32_t i = 0; i < m_Headers.size(); ++i)
+    {
+        m_Headers[i].type = Message::Data;
+        m_Headers[i].index = i;
+    }
 }
 
-/*
- * Check sums scheme:
- * first 2 bytes - size of single page
- * than  8 bytes sequence of unique identifier for every page
-*/
-void SubmitInfo::genChecksums()
+// parity pages are sent after data ones, so a page lost from a group is rebuilt without asking for it;
+// groups are interleaved (page i belongs to group i % groups), so a burst of drops hits many groups once
+void SubmitInfo::genParity()
 {
-    m_Checksums.resize(m_Pages.size() * sizeof(double) + 2);
-    memcpy(m_Checksums.data(), &PAGE_SIZE, 2);
-    uint32_t shift = 2;
-    for(const auto& page: m_Pages)
+    if(!m_Group)
+        return;
+
+    const uint32_t perPage = m_PageSize / sizeof(double);
+    const uint32_t groups = m_Headers.size() - m_Pages.size();
+    m_Parity.assign(groups * perPage, 0.);
+
+    for(uint32_t i = 0; i < m_Pages.size(); ++i)
+        xorInto(m_Parity.data() + i % groups * perPage, (const double*)m_Pages[i].data(), m_Pages[i].size() / sizeof(double));
+}
+
+// FEC works on raw values, so parity pages are encoded like data ones; a page the codec
+// doesn't shrink (parity, as a rule) stays raw
+void SubmitInfo::pack()
+{
+    if(m_Codec == Codec::Raw)
+        return;
+
+    std::vector<std::size_t> offsets;
+    m_Packed.resize(m_Headers.size() * compressBound(m_PageSize / sizeof(double)));
+    std::size_t size = 0;
+
+    for(uint32_t i = 0; i < m_Headers.size(); ++i)
     {
-        // I use first value in page "like" checksum, because actually
-        // all value are unique and than any false positive impossible...
-        memcpy(m_Checksums.data() + shift, page.data(), 8);
-        shift += 8;
+        auto raw = page(i);
+        std::size_t packed = compress((const double*)raw.data(), raw.size() / sizeof(double), m_Codec, m_Packed.data() + size);
+        if(packed >= raw.size())
+        {
+            memcpy(m_Packed.data() + size, raw.data(), raw.size());
+            packed = raw.size();
+        }
+        else
+            m_Headers[i].codec = m_Codec;
+
+        offsets.push_back(size);
+        size += packed;
     }
+
+    // buffers are taken after the last write, vector doesn't move anymore
+    m_Packed.resize(size);
+    m_Packed.shrink_to_fit();
+    for(uint32_t i = 0; i < m_Headers.size(); ++i)
+        m_Encoded.emplace_back(m_Packed.data() + offsets[i], (i + 1 < offsets.size() ? offsets[i + 1] : size) - offsets[i]);
 }
 
+// once per page, retransmits reuse it; covers header too, so a page can't land at a wrong index
+void SubmitInfo::genChecksums()
+{
+    for(uint32_t i = 0; i < m_Headers.size(); ++i)
+    {
+        auto payload = page(i);
+        m_Headers[i].crc = 0;
+        m_Headers[i].crc = crc32c(payload.data(), payload.size(), crc32c(&m_Headers[i], sizeof(Header)));
+    }
+}
\ No newline at end of file
@@ -2,9 +2,12 @@
 #define UDP_SERVER_SUBMIT_INFO_H
 
 
+#include "config.h"
 #include "datastorage.h"
+#include "../common/protocol.h"
 #include <boost/asio/buffer.hpp>
 #include <boost/asio/ip/udp.hpp>
+#include <chrono>
 #include <memory>
 #include <vector>
 
@@ -14,22 +17,55 @@ using boost::asio::ip::udp;
 class SubmitInfo
 {
     CStorage                       m_Storage;
+    uint16_t                       m_PageSize; // values only, without header
     std::vector<const_buffer>      m_Pages;
-    std::vector<std::byte>         m_Checksums;
+    uint32_t                       m_Group;
+    std::vector<double>            m_Parity;   // one page per group of m_Group data pages
+    Codec                          m_Codec;
+    std::vector<std::byte>         m_Packed;   // every page encoded, back to back
+    std::vector<const_buffer>      m_Encoded;  // data and parity pages in m_Packed, empty when raw
+    std::vector<Header>            m_Headers;  // data pages, then parity pages
+    Header                         m_End;
+    uint32_t                       m_Session;
     std::shared_ptr<udp::endpoint> m_Destination;
+    std::chrono::steady_clock::time_point m_Accepted; // of the request, for stats
+    std::shared_ptr<const SubmitInfo> m_Round;  // multicast round whose pages are resent, nullptr for own pages
 
     private:
+        // owner of the pages and headers
+        const SubmitInfo& built() const { return m_Round ? *m_Round : *this; }
+
         void paginate();
+        void genParity();
+        void pack();
         void genChecksums();
 
     public:
-        SubmitInfo(CStorage storage, std::shared_ptr<udp::endpoint> dst);
+        // pageSize is size of datagram, header included; fecGroup data pages per parity page, 0 for none;
+        // session is echoed in every header; pages which codec doesn't shrink are sent raw
+        SubmitInfo(CStorage storage, std::shared_ptr<udp::endpoint> dst, uint16_t pageSize = PAGE_SIZE, uint32_t fecGroup = 0,
+            uint32_t session = 0, Codec codec = Codec::Raw, std::chrono::steady_clock::time_point accepted = {});
+        // subscriber of a multicast round: nothing is built, lost pages are resent as the round sent them,
+        // under the round's session, which the client takes on either socket
+        SubmitInfo(std::shared_ptr<const SubmitInfo> round, std::shared_ptr<udp::endpoint> dst, uint32_t session,
+            std::chrono::steady_clock::time_point accepted = {});
         
-        const std::vector<const_buffer>& pages() const { return m_Pages; }
-        const std::vector<std::byte>& checksums() const { return m_Checksums; }
+        // data pages only, raw
+        const std::vector<const_buffer>& pages() const { return built().m_Pages; }
+        // data and parity pages
+        uint32_t datagrams() const { return built().m_Headers.size(); }
+        // payload as sent, encoded if compression is on
+        const_buffer page(uint32_t index) const;
+        const_buffer header(uint32_t index) const { return const_buffer(&built().m_Headers[index], sizeof(Header)); }
+        // closes every (re)submit, carries the layout like page headers do
+        const_buffer end() const { return const_buffer(&built().m_End, sizeof(Header)); }
+        // header of End under another type and own session, for other messages carrying the layout
+        Header layout(Message type) const { Header header = built().m_End; header.type = type; header.session = m_Session; return header; }
+        bool subscriber() const { return m_Round != nullptr; }
+        const CStorage& storage() const { return m_Storage; }
+        uint32_t session() const { return m_Session; }
+        std::chrono::steady_clock::time_point accepted() const { return m_Accepted; }
         std::shared_ptr<udp::endpoint> dst() const {return m_Destination; }
 };
 
-using SubmitQueue = std::vector<std::shared_ptr<SubmitInfo>>;
-
 #endif // UDP_SERVER_SUBMIT_INFO_H
\ No newline at end of file
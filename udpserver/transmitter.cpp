@@ -0,0 +1,356 @@
+#include "transmitter.h"
+#include <algorithm>
+#include <array>
+#include <boost/asio/error.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/system/error_code.hpp>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+using boost::system::error_code;
+
+Transmitter::TokenBucket::TokenBucket(double rate, double depth)
+    : rate(rate)
+    , depth(depth)
+    , tokens(depth)
+    , refilled(Clock::now())
+{
+
+}
+
+void Transmitter::TokenBucket::refill(Clock::time_point now)
+{
+    if(std::isinf(rate))
+        tokens = depth;
+    else
+        tokens = std::min(depth, tokens + rate * std::chrono::duration<double>(now - refilled).count());
+    refilled = now;
+}
+
+Transmitter::Clock::duration Transmitter::TokenBucket::wait(double threshold) const
+{
+    if(tokens >= threshold)
+        return Clock::duration::zero();
+    return std::chrono::ceil<Clock::duration>(std::chrono::duration<double>((threshold - tokens) / rate));
+}
+
+Transmitter::Transmitter(udp::socket& socket, std::shared_ptr<Logger> log, Pacing pacing, bool segmentation)
+    : m_Socket(socket)
+    , m_Tick(socket.get_executor())
+    , m_Pacing(pacing)
+    , m_Segmentation(segmentation)
+    , m_Log(std::move(log))
+    , m_Global(pacing.globalRate, pacing.burst * TRANSMIT_BATCH)
+{
+
+}
+
+void Transmitter::send(const udp::endpoint& dst, const_buffer payload, std::shared_ptr<const void> owner)
+{
+    send(dst, const_buffer(), payload, std::move(owner));
+}
+
+void Transmitter::send(const udp::endpoint& dst, const_buffer header, const_buffer payload, std::shared_ptr<const void> owner)
+{
+    auto now = Clock::now();
+    auto [iter, _] = m_Flows.try_emplace(dst, Flow{{}, TokenBucket(m_Pacing.flowRate, m_Pacing.burst)});
+    auto& flow = iter->second;
+
+    flow.pending.push_back({header, payload, std::move(owner)});
+    flow.active = now;
+
+    if(m_State == State::Idle)
+    {
+        post();
+    }
+    else if(m_State == State::Timer && flow.pending.size() == 1)
+    {
+        // timer was armed for other throttled destinations, don't make this one wait for them
+        flow.bucket.refill(now);
+        m_Global.refill(now);
+        if(flow.bucket.ready() && m_Global.ready())
+        {
+            m_Tick.cancel();
+            post();
+        }
+    }
+}
+
+void Transmitter::congested(const udp::endpoint& dst, uint32_t lost)
+{
+    auto iter = m_Flows.find(dst);
+    if(iter == m_Flows.end())
+        return;
+
+    auto& flow = iter->second;
+    double loss = lost / (double)std::max<uint64_t>(flow.sent, lost);
+
+    flow.bucket.rate = std::max(m_Pacing.minRate, flow.bucket.rate * std::max(0.5, 1. - loss));
+    flow.sent = 0;
+    flow.congested = true;
+}
+
+void Transmitter::congested(const udp::endpoint& dst, uint32_t lost, uint32_t sent)
+{
+    auto iter = m_Flows.find(dst);
+    if(iter == m_Flows.end())
+        return;
+
+    auto& flow = iter->second;
+    double loss = lost / (double)std::max(sent, lost);
+    if(loss <= flow.worst)
+        return;
+
+    // cut of the previous worst receiver is replaced, not compounded
+    flow.bucket.rate = std::max(m_Pacing.minRate, flow.bucket.rate / std::max(0.5, 1. - flow.worst) * std::max(0.5, 1. - loss));
+    flow.worst = loss;
+    flow.congested = true;
+}
+
+void Transmitter::release(const udp::endpoint& dst)
+{
+    m_Flows.erase(dst);
+}
+
+double Transmitter::rate(const udp::endpoint& dst) const
+{
+    auto iter = m_Flows.find(dst);
+    return iter == m_Flows.end() ? m_Pacing.flowRate : iter->second.bucket.rate;
+}
+
+void Transmitter::post()
+{
+    m_State = State::Posted;
+    boost::asio::post(m_Socket.get_executor(), [this]() { transmit(); });
+}
+
+void Transmitter::schedule()
+{
+    if(m_State != State::Idle)
+        return;
+
+    bool pending = false;
+    auto wait = Clock::duration::max();
+
+    for(const auto& [_, flow] : m_Flows)
+    {
+        if(flow.pending.empty())
+            continue;
+        pending = true;
+        // wake up when a bunch of datagrams may leave, not the single one
+        wait = std::min(wait, flow.bucket.wait(flow.bucket.ready() ? 0 : flow.bucket.depth / 4));
+    }
+
+    if(!pending)
+        return;
+
+    wait = std::max(wait, m_Global.wait());
+
+    if(wait == Clock::duration::zero())
+    {
+        post();
+        return;
+    }
+
+    m_State = State::Timer;
+    m_Tick.expires_after(wait);
+    m_Tick.async_wait([this](const error_code& error)
+    {
+        if(error == boost::asio::error::operation_aborted)
+            return;
+        m_Log->log(error);
+        transmit();
+    });
+}
+
+void Transmitter::expire(Clock::time_point now)
+{
+    std::erase_if(m_Flows, [=](const auto& item)
+    {
+        return item.second.pending.empty() && now - item.second.active > PACING_IDLE_TIMEOUT;
+    });
+}
+
+void Transmitter::transmit()
+{
+    m_State = State::Idle;
+
+    if(m_Flows.empty())
+        return;
+
+    auto now = Clock::now();
+    m_Global.refill(now);
+    for(auto& [_, flow] : m_Flows)
+        flow.bucket.refill(now);
+
+    std::array<mmsghdr, TRANSMIT_BATCH>  headers{};
+    std::array<iovec, TRANSMIT_BATCH * GSO_MAX_SEGMENTS * 2> vectors; // header and payload
+    std::array<Flow*, TRANSMIT_BATCH>    owners{};
+    std::array<uint32_t, TRANSMIT_BATCH> segments{};
+    std::array<uint32_t, TRANSMIT_BATCH> bytes{};
+    std::array<uint16_t, TRANSMIT_BATCH> segmentSizes{};
+    alignas(cmsghdr) std::array<std::array<char, CMSG_SPACE(sizeof(uint16_t))>, TRANSMIT_BATCH> controls;
+
+    uint32_t count = 0;
+    iovec* vector = vectors.data();
+
+    // round-robin over destinations, one message per destination per round
+    for(bool progress = true; progress && count < TRANSMIT_BATCH && m_Global.ready();)
+    {
+        progress = false;
+        auto iter = m_Flows.upper_bound(m_Cursor);
+
+        for(std::size_t n = 0; n < m_Flows.size() && count < TRANSMIT_BATCH && m_Global.ready(); ++n, ++iter)
+        {
+            if(iter == m_Flows.end())
+                iter = m_Flows.begin();
+
+            auto& [dst, flow] = *iter;
+
+            // datagrams of this flow already taken into the batch
+            uint32_t offset = 0;
+            for(uint32_t i = 0; i < count; ++i)
+                if(owners[i] == &flow)
+                    offset += segments[i];
+
+            if(offset == flow.pending.size() || !flow.bucket.ready())
+                continue;
+
+            auto& header = headers[count].msg_hdr;
+            header.msg_name = const_cast<udp::endpoint&>(dst).data();
+            header.msg_namelen = dst.size();
+            header.msg_iov = vector;
+
+            auto datagramSize = [](const Datagram& datagram) { return datagram.header.size() + datagram.payload.size(); };
+
+            uint32_t size = datagramSize(flow.pending[offset]);
+            uint32_t last = size;
+            const char* end = nullptr;
+            uint32_t glued = 0;
+
+            // glue following datagrams whose payload lies right after this one, all but the last must be of equal size
+            do
+            {
+                const auto& datagram = flow.pending[offset + glued];
+                if(datagram.header.size())
+                    *vector++ = {const_cast<void*>(datagram.header.data()), datagram.header.size()};
+                *vector++ = {const_cast<void*>(datagram.payload.data()), datagram.payload.size()};
+                end = static_cast<const char*>(datagram.payload.data()) + datagram.payload.size();
+                last = datagramSize(datagram);
+                ++glued;
+                bytes[count] += last;
+            }
+            while(m_Segmentation
+                && offset + glued < flow.pending.size()
+                && glued < GSO_MAX_SEGMENTS
+                && last == size
+                && flow.pending[offset + glued].payload.data() == end
+                && flow.pending[offset + glued].header.size() == flow.pending[offset].header.size()
+                && datagramSize(flow.pending[offset + glued]) <= size
+                && bytes[count] + datagramSize(flow.pending[offset + glued]) <= GSO_MAX_PAYLOAD);
+
+            header.msg_iovlen = vector - header.msg_iov;
+
+            if(glued > 1)
+            {
+                header.msg_control = controls[count].data();
+                header.msg_controllen = controls[count].size();
+                cmsghdr* control = CMSG_FIRSTHDR(&header);
+                control->cmsg_level = SOL_UDP;
+                control->cmsg_type = UDP_SEGMENT;
+                control->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                segmentSizes[count] = size;
+                memcpy(CMSG_DATA(control), &segmentSizes[count], sizeof(uint16_t));
+            }
+
+            flow.bucket.tokens -= bytes[count];
+            m_Global.tokens -= bytes[count];
+
+            owners[count] = &flow;
+            segments[count] = glued;
+            ++count;
+
+            m_Cursor = dst;
+            progress = true;
+        }
+    }
+
+    if(count == 0)
+    {
+        schedule();
+        return;
+    }
+
+    int sent = ::sendmmsg(m_Socket.native_handle(), headers.data(), count, MSG_DONTWAIT);
+    int error = sent < 0 ? errno : 0;
+    ++m_Syscalls;
+
+    auto refund = [&](uint32_t from)
+    {
+        for(uint32_t i = from; i < count; ++i)
+        {
+            owners[i]->bucket.tokens += bytes[i];
+            m_Global.tokens += bytes[i];
+        }
+    };
+
+    if(sent < 0)
+    {
+        if(error == EAGAIN || error == EWOULDBLOCK)
+        {
+            refund(0);
+            m_State = State::Writable;
+            m_Socket.async_wait(udp::socket::wait_write, [this](const error_code& error)
+            {
+                m_Log->log(error);
+                transmit();
+            });
+            return;
+        }
+
+        m_Log->log(error_code(error, boost::system::system_category()));
+
+        if(segments[0] > 1 && (error == EIO || error == EINVAL || error == ENOPROTOOPT))
+        {
+            // no GSO support on this path, send the same datagrams one by one
+            m_Log->log("UDP_SEGMENT rejected, segmentation disabled", Level::Warning);
+            m_Segmentation = false;
+            refund(0);
+            post();
+            return;
+        }
+
+        // kernel refused first datagram (e.g. unreachable destination),
+        // drop it, otherwise it blocks whole queue
+        owners[0]->pending.erase(owners[0]->pending.begin(), owners[0]->pending.begin() + segments[0]);
+        sent = 0;
+    }
+
+    refund(sent);
+
+    // sent messages are prefix of the batch, and so prefix of every flow queue
+    for(uint32_t i = 0; i < (uint32_t)sent; ++i)
+    {
+        auto& flow = *owners[i];
+        flow.pending.erase(flow.pending.begin(), flow.pending.begin() + segments[i]);
+        flow.sent += segments[i];
+        flow.active = now;
+        m_Sent += segments[i];
+
+        if(flow.pending.empty())
+        {
+            // whole submit left without NACK for the previous one, probe for more bandwidth
+            if(!flow.congested)
+                flow.bucket.rate = std::min(m_Pacing.flowRate, flow.bucket.rate * 1.25);
+            flow.congested = false;
+            flow.worst = 0;
+        }
+    }
+
+    expire(now);
+    schedule();
+}
@@ -0,0 +1,117 @@
+#ifndef UDP_SERVER_TRANSMITTER_H
+#define UDP_SERVER_TRANSMITTER_H
+
+#include "config.h"
+#include "../common/logger.h"
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+
+using boost::asio::ip::udp;
+using boost::asio::const_buffer;
+
+struct Pacing
+{
+    double flowRate   = PACING_FLOW_RATE;
+    double minRate    = PACING_MIN_RATE;
+    double globalRate = PACING_GLOBAL_RATE;
+    double burst      = PACING_BURST;
+};
+
+/*
+ * Batched and paced transmit engine.
+ * Datagrams are queued per destination and handed to the kernel with sendmmsg,
+ * up to TRANSMIT_BATCH messages (taken round-robin across destinations) per syscall.
+ * Datagram may have a header in separate memory, it's gathered in front of payload by the kernel.
+ * With segmentation enabled, a run of equal-size datagrams with payloads lying back to back in memory
+ * becomes a single message with UDP_SEGMENT, and the kernel (or NIC) splits it.
+ * If the kernel rejects UDP_SEGMENT, segmentation is switched off and datagrams are sent one by one.
+ * Every destination owns a token bucket, all of them are capped by one global bucket.
+ * When nothing may leave, the engine arms a timer on the io_context for the moment
+ * the first bucket refills, so the thread is never blocked.
+ * Must be used only from the thread running the socket's io_context.
+*/
+class Transmitter
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Datagram
+    {
+        const_buffer                   header;  // may be empty
+        const_buffer                   payload;
+        std::shared_ptr<const void>    owner; // keeps payload memory alive until sent
+    };
+
+    // tokens may go negative, so datagram bigger than depth still leaves, later ones wait for the debt
+    struct TokenBucket
+    {
+        double              rate;
+        double              depth;
+        double              tokens;
+        Clock::time_point   refilled;
+
+        TokenBucket(double rate, double depth);
+
+        void refill(Clock::time_point now);
+        bool ready() const { return tokens >= 0; }
+        Clock::duration wait(double threshold = 0) const;
+    };
+
+    struct Flow
+    {
+        std::deque<Datagram>    pending;
+        TokenBucket             bucket;
+        uint64_t                sent = 0;       // datagrams since last feedback
+        bool                    congested = false;
+        double                  worst = 0;      // shared flow: highest loss of a receiver since it last drained
+        Clock::time_point       active = {};
+    };
+
+    enum class State { Idle, Posted, Timer, Writable };
+
+    udp::socket&                        m_Socket;
+    boost::asio::steady_timer           m_Tick;
+    Pacing                              m_Pacing;
+    bool                                m_Segmentation;
+    std::shared_ptr<Logger>             m_Log;
+
+    std::map<udp::endpoint, Flow>       m_Flows;
+    udp::endpoint                       m_Cursor;   // last served destination, for round-robin
+    TokenBucket                         m_Global;
+    State                               m_State = State::Idle;
+
+    uint64_t                            m_Syscalls = 0;
+    uint64_t                            m_Sent = 0;
+
+    private:
+        void transmit();
+        void schedule();
+        void post();
+        void expire(Clock::time_point now);
+
+    public:
+        Transmitter(udp::socket& socket, std::shared_ptr<Logger> log, Pacing pacing = {}, bool segmentation = false);
+
+        void send(const udp::endpoint& dst, const_buffer payload, std::shared_ptr<const void> owner);
+        void send(const udp::endpoint& dst, const_buffer header, const_buffer payload, std::shared_ptr<const void> owner);
+
+        // feedback from receivers
+        void congested(const udp::endpoint& dst, uint32_t lost);
+        // from one of many receivers of a shared flow (multicast group), lost of sent datagrams,
+        // the worst receiver since the flow last drained sets its rate
+        void congested(const udp::endpoint& dst, uint32_t lost, uint32_t sent);
+        void release(const udp::endpoint& dst);
+
+        bool idle() const { return m_State == State::Idle; }
+        bool segmentation() const { return m_Segmentation; }
+        double rate(const udp::endpoint& dst) const;
+        uint64_t syscalls() const { return m_Syscalls; }
+        uint64_t sent() const { return m_Sent; }
+};
+
+#endif // UDP_SERVER_TRANSMITTER_H
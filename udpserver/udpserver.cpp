@@ -2,9 +2,12 @@
 #include "config.h"
 #include "datastorage.h"
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <boost/asio/buffer.hpp>
 #include <boost/asio/buffered_stream.hpp>
 #include <boost/asio/ip/udp.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/asio/steady_timer.hpp>
 #include <boost/system/error_code.hpp>
 #include <chrono>
@@ -14,13 +17,16 @@
 #include <limits>
 #include <memory>
 #include <mutex>
-#include <shared_mutex>
 #include <span>
 #include <string>
 #include <thread>
 #include <vector>
 #include <optional>
+#include <random>
+#include <stdexcept>
+#include "handoff.h"
 #include "submitinfo.h"
+#include "../common/protocol.h"
 
 struct Index
 {
@@ -33,57 +39,146 @@ struct Index
     }
 };
 
-Server::Server(uint16_t port)
-    : m_Context()
-    , m_Port(port)
-    , m_Socket(m_Context, {udp::v6(), m_Port})
-    , m_Strand(m_Context)
-    , m_Generator(std::thread::hardware_concurrency() - 1)
-    , m_Log(std::make_shared<FileLogger>("server.log"))
+// dataset finished by generator, waiting for network thread of its shard
+struct Completion
 {
-    m_InOutThread = std::jthread([this]()
+    CStorage                        storage;
+    std::shared_ptr<udp::endpoint>  dst;
+    uint32_t                        session;
+    uint64_t                        flags;
+    Timestamp                       accepted;
+};
+
+struct Shard
+{
+    boost::asio::io_context         context;
+    udp::socket                     socket;
+    Transmitter                     transmitter;
+    Handoff<Completion>             completed;
+    steady_timer                    expiry;
+    std::byte                       buffer[65515/*max possible udp packet*/];
+    std::jthread                    thread;
+
+    Shard(const Settings& settings, std::shared_ptr<Logger> log)
+        : context()
+        , socket(context, udp::v6())
+        , transmitter(socket, std::move(log), Pacing{.burst = settings.pacingBurst * 1024.}, settings.gso)
+        , completed(context)
+        , expiry(context)
     {
-        receive();
-        m_Context.run();
-    });
+        // kernel spreads clients across sockets by flow hash, so every client stays on one shard
+        if(settings.shards > 1)
+            socket.set_option(boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+        socket.bind({udp::v6(), settings.port});
+    }
+};
+
+static uint32_t generatorThreads(const Settings& settings)
+{
+    return std::max(1, (int)std::thread::hardware_concurrency() - (int)settings.shards);
 }
 
-void Server::receive()
+Server::Server(const Settings& settings)
+    : m_Settings(settings)
+    , m_Port(settings.port)
+    , m_Log(std::make_shared<FileLogger>("server.log", parseLevel(settings.logLevel).value_or(Level::Info)))
+    , m_Pool((uint64_t)settings.memoryLimit << 20, settings.hugePages, generatorThreads(settings))
+    , m_Cache(((uint64_t)settings.cacheLimit << 20) / (GENERATOR_THRESHOLD * sizeof(double)))
+    , m_Generator(generatorThreads(settings), m_Pool, settings.split, &m_Stats)
 {
-    auto sender = std::make_shared<udp::endpoint>();
+    if(!settings.multicast.empty())
+    {
+        // sockets are IPv6, IPv4 group is reached through mapped address
+        auto group = boost::asio::ip::make_address(settings.multicast);
+        if(!group.is_multicast())
+            throw std::runtime_error("multicast must be group address");
+        auto v6 = group.is_v4() ? boost::asio::ip::make_address_v6(boost::asio::ip::v4_mapped, group.to_v4()) : group.to_v6();
+        m_Multicast = std::make_shared<udp::endpoint>(v6, settings.multicastPort ? settings.multicastPort : settings.port + 1);
+    }
+
+    for(uint32_t i = 0; i < std::max(1u, settings.shards); ++i)
+        m_Shards.push_back(std::make_unique<Shard>(settings, m_Log));
+
+    // session table is shared, one shard is enough to sweep it
+    expire(*m_Shards.front());
+    if(settings.statsInterval)
+        dumpStats(*m_Shards.front());
 
-    m_Socket.async_receive_from(boost::asio::buffer(m_Buffer, 65515), *sender,
-        [=, this](error_code ec, uint64_t recvd)
+    for(auto& shard : m_Shards)
+    {
+        shard->completed.start([this, &shard = *shard](Completion completion)
         {
-            m_Log->log(ec);
-            if(recvd == sizeof(double))
-                processNewConnection(std::move(sender));
+            publish(shard, std::move(completion));
+        });
 
-            else if(recvd == 1) // just means client successfully receive all data
-                forget(std::move(sender));
+        shard->thread = std::jthread([this, &shard = *shard]()
+        {
+            receive(shard);
+            shard.context.run();
+        });
+    }
+}
 
-            else if(recvd % 2 == 1) // page indexes
-                resubmitLost(std::move(sender), recvd - 1);
+Server::~Server()
+{
+    for(auto& shard : m_Shards)
+        shard->context.stop();
+}
 
-            else if(recvd % 2 == 0) // received checksums
-                resubmitChecksums(std::move(sender), recvd - 2);
+void Server::receive(Shard& shard)
+{
+    auto sender = std::make_shared<udp::endpoint>();
 
-            receive();
+    shard.socket.async_receive_from(boost::asio::buffer(shard.buffer, 65515), *sender,
+        [=, this, &shard](error_code ec, uint64_t recvd)
+        {
+            Header header;
+            if(!m_Log->log(ec) && recvd >= sizeof(header))
+                memcpy(&header, shard.buffer, sizeof(header));
+            else
+                header.magic = 0; // nothing to dispatch
+
+            if(header.magic != PROTOCOL_MAGIC)
+                ; // not ours, not even worth an answer
+
+            else if(header.version != PROTOCOL_VERSION)
+                refuse(shard, *sender, header.session, "unsupported protocol version");
+
+            else switch(header.type)
+            {
+                case Message::Request:
+                    processNewConnection(shard, std::move(sender), header.session, recvd - sizeof(header));
+                    break;
+                case Message::Nack:
+                    resubmitLost(shard, std::move(sender), header, recvd - sizeof(header));
+                    break;
+                case Message::Ack: // client successfully received all data
+                    forget(shard, std::move(sender), header.session);
+                    break;
+                case Message::Stats:
+                    reportStats(shard, *sender, header.session);
+                    break;
+                default:
+                    m_Log->log("unexpected message", Level::Warning);
+            }
+
+            receive(shard);
         }
     );
 }
 
 void Server::runLoop()
 {
-    if(m_InOutThread.joinable())
-        m_InOutThread.join();
+    for(auto& shard : m_Shards)
+        if(shard->thread.joinable())
+            shard->thread.join();
 }
 
-bool/*is valid*/ Server::validate(std::shared_ptr<udp::endpoint> endpoint, double seed)
+bool/*is valid*/ Server::validate(Shard& shard, std::shared_ptr<udp::endpoint> endpoint, uint32_t session, double seed)
 {
     std::optional<std::string> error;
 
-    if(endpoint->protocol().family() != m_Socket.local_endpoint().protocol().family())
+    if(endpoint->protocol().family() != shard.socket.local_endpoint().protocol().family())
         error = "Protocol mismatch";
 
     // because we use range [-X; X] enough have at least GENERATOR_THRESHOLD / 2 epsilons in seed 
@@ -93,129 +188,300 @@ bool/*is valid*/ Server::validate(std::shared_ptr<udp::endpoint> endpoint, doubl
     // other checks...
 
     if(error)
-    {
-        std::string msg = *error;
-        if(msg.size() % 2 == 0)
-            msg.push_back(' '/*padding just to ensure client not recognize data and fall in error*/);
-        m_Socket.send_to(const_buffer(error->data(), error->size()), *endpoint);
-    }
+        refuse(shard, *endpoint, session, *error);
 
     return !error.has_value();
 }
 
-void Server::submit(std::shared_ptr<udp::endpoint> dst, const std::vector<const_buffer>& pages, std::function<Index()> nextIdx)
+void Server::refuse(Shard& shard, const udp::endpoint& endpoint, uint32_t session, std::string msg)
 {
-    Index idx = nextIdx();
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
-    m_Socket.async_send_to(pages[idx], *dst,
-        m_Strand.wrap([=, this](const error_code& error, std::size_t transferred) 
-        {
-            m_Log->log(error);
-            if(!idx.last)
-                submit(std::move(dst), pages, std::move(nextIdx));
-            else
-                m_Socket.send_to(boost::asio::buffer(&m_Buffer, 1), *dst);
-        }
-    ));
+    m_Stats.add(Counter::Refused);
+    Header header{.type = Message::Refuse, .session = session};
+    shard.socket.send_to(std::array{const_buffer(&header, sizeof(header)), const_buffer(msg.data(), msg.size())}, endpoint);
 }
 
-void Server::submit(std::shared_ptr<udp::endpoint> dst, const std::vector<std::byte>& checksums)
+void Server::submit(Shard& shard, std::shared_ptr<udp::endpoint> dst, std::shared_ptr<const SubmitInfo> info, std::function<Index()> nextIdx,
+    std::optional<Timestamp> accepted)
 {
-    m_Socket.async_send_to(const_buffer(checksums.data(), checksums.size()), *dst,
-        m_Strand.wrap([this](const error_code& error, std::size_t transferred) { m_Log->log(error);}));
+    // owner of a datagram is dropped by the transmitter right after the kernel took it,
+    // so an owner which records the stage on release marks the moment the datagram left
+    auto milestone = [&](Stage stage) -> std::shared_ptr<const void>
+    {
+        if(!accepted)
+            return info;
+        return std::shared_ptr<const void>(info.get(), [this, info, stage, at = *accepted](const void*) { m_Stats.record(stage, at); });
+    };
+
+    auto owner = milestone(Stage::FirstPage);
+    for(Index idx = nextIdx(); ; idx = nextIdx())
+    {
+        shard.transmitter.send(*dst, info->header(idx.index), info->page(idx.index), std::move(owner));
+        owner = info;
+        if(idx.last)
+            break;
+    }
+
+    // client answers it with lost pages or ack
+    shard.transmitter.send(*dst, info->end(), const_buffer(), milestone(Stage::LastPage));
 }
 
-void Server::processNewConnection(std::shared_ptr<udp::endpoint> dst)
+void Server::processNewConnection(Shard& shard, std::shared_ptr<udp::endpoint> dst, uint32_t session, uint32_t recvd)
 {
-    double seed;
-    memcpy(&seed, m_Buffer, sizeof(double));
+    if(recvd != sizeof(Request))
+    {
+        refuse(shard, *dst, session, "malformed request");
+        return;
+    }
+
+    Request request;
+    memcpy(&request, shard.buffer + sizeof(Header), sizeof(request));
+    m_Stats.add(Counter::Requests);
+    auto accepted = std::chrono::steady_clock::now();
 
-    if(!validate(dst, seed))
+    if(!validate(shard, dst, session, request.seed))
         return;
 
-    auto submitCallback = [=, this](CStorage storage)
+    // runs on generator thread, just hands dataset over to the shard
+    auto submitCallback = [this, dst, session, flags = request.flags, accepted, &shard](CStorage storage)
     {
-        auto info = std::make_shared<SubmitInfo>(std::move(storage), dst);
-
-        {
-            std::unique_lock _(m_submitQMtx);
-            m_submitQueue.push_back(info);
-        }
+        if(storage)
+            m_Stats.record(Stage::Generated, accepted);
+        shard.completed.push({std::move(storage), dst, session, flags, accepted});
+    };
 
-        std::shared_lock _(m_submitQMtx);
+    bool sorted = request.flags & FLAG_SORTED;
 
-        submit(dst, info->checksums());
+    // every dataset in flight pins its storage, over memory limit client has to come back later
+    if(!(request.flags & FLAG_DETERMINISTIC))
+    {
+        if(!generate(request.seed, std::move(submitCallback), sorted))
+            refuse(shard, *dst, session, "server busy");
+        return;
+    }
 
-        submit(dst, info->pages(),
-        [i = 0u, end = info->pages().size()]() mutable -> Index
-        { return {i, ++i == end}; });
-    };
+    // repeated request skips the generator, identical ones in flight share a single job
+    DatasetKey key{request.seed, request.nonce, sorted};
+    CStorage storage;
 
-    m_Generator.addNewInstance(seed, std::move(submitCallback));
+    switch(m_Cache.join(key, std::move(submitCallback), storage))
+    {
+        case DatasetCache::Lookup::Cached:
+            m_Stats.add(Counter::CacheHits);
+            m_Stats.record(Stage::Generated, accepted);
+            publish(shard, {std::move(storage), dst, session, request.flags, accepted});
+            break;
+        case DatasetCache::Lookup::Pending:
+            break;
+        case DatasetCache::Lookup::Missing:
+            // waiters get nullptr on failure and are refused by their shards
+            if(!generate(request.seed, [this, key](CStorage storage) { m_Cache.complete(key, std::move(storage)); }, sorted, key.generatorKey()))
+                m_Cache.complete(key, nullptr);
+            break;
+    }
 }
 
-void Server::resubmitChecksums(std::shared_ptr<udp::endpoint> dst, uint32_t recvd)
+bool Server::generate(double seed, SubmitCallback ready, bool sorted, std::optional<uint64_t> key)
 {
-    std::vector<double> cs;
-    cs.resize((recvd - 2/*padding*/) / 8);
-    memcpy(cs.data(), m_Buffer, recvd - 2/*padding*/);
+    // cached datasets give way to new ones
+    while(!m_Generator.addNewInstance(seed, ready, sorted, key))
+        if(!m_Cache.evict())
+            return false;
+    return true;
+}
 
-    std::shared_lock _(m_submitQMtx);
+void Server::publish(Shard& shard, Completion completion)
+{
+    auto& dst = completion.dst;
 
-    if(m_submitQueue.empty())
+    if(!completion.storage)
     {
-        m_Log->log("submit queue empty");
+        refuse(shard, *dst, completion.session, "server busy");
         return;
     }
 
-    const auto& info = *std::find_if(m_submitQueue.begin(), m_submitQueue.end(),
-        [=](const auto& val) { return val->dst() == dst; });
+    // neighbours of sorted dataset differ in low bits only, XOR with previous value zeroes the rest
+    Codec codec = !m_Settings.compress ? Codec::Raw : completion.flags & FLAG_SORTED ? Codec::XorShuffle : Codec::Shuffle;
 
-    submit(dst, info->checksums());
+    if(m_Multicast && (completion.flags & FLAG_MULTICAST) && (completion.flags & FLAG_DETERMINISTIC))
+    {
+        subscribe(shard, std::move(completion), codec);
+        return;
+    }
 
-    std::vector<uint16_t> idx;
+    auto info = std::make_shared<SubmitInfo>(std::move(completion.storage), dst, m_Settings.gso ? GSO_PAGE_SIZE : PAGE_SIZE,
+        m_Settings.fec, completion.session, codec, completion.accepted);
 
-    auto checksums = std::span<double>((double*)(info->checksums().data() + 2), (info->checksums().size() - 2) / 8);
+    m_Sessions.insert(info);
+
+    // parity pages go after data ones, resubmits send data pages only
+    m_Stats.add(Counter::PagesSent, info->datagrams());
+    submit(shard, dst, info,
+    [i = 0u, end = info->datagrams()]() mutable -> Index
+    { return {i, ++i == end}; }, completion.accepted);
+}
 
-    for(uint32_t i = 0; i < checksums.size(); ++i)
+// requests for the same deterministic dataset share its storage, every one published before the round
+// of the dataset starts subscribes to it, so pages are built and sent once however many clients there are;
+// a subscriber's session only points at the round, its lost pages are resent to it alone from the round's pages.
+// Rounds leave through the first shard, so the group is a single paced flow
+void Server::subscribe(Shard& shard, Completion completion, Codec codec)
+{
+    std::shared_ptr<const SubmitInfo> round;
+    bool opened = false;
     {
-        if(std::find(cs.begin(), cs.end(), checksums[i]) != cs.end())
-            idx.push_back(i);
+        std::lock_guard _(m_RoundsLock);
+        auto& slot = m_Rounds[completion.storage.get()];
+        if(!slot)
+        {
+            slot = std::make_shared<SubmitInfo>(completion.storage, m_Multicast, m_Settings.gso ? GSO_PAGE_SIZE : PAGE_SIZE,
+                m_Settings.fec, std::random_device()(), codec, completion.accepted);
+            opened = true;
+        }
+        round = slot;
     }
 
-    submit(std::move(dst), info->pages(), [i = 0u, ind = idx]() mutable -> Index 
+    auto info = std::make_shared<SubmitInfo>(round, completion.dst, completion.session, completion.accepted);
+    m_Sessions.insert(info);
+
+    Header header = info->layout(Message::Subscribe);
+    Subscription subscription{.port = m_Multicast->port(), .session = round->session()};
+    auto group = m_Multicast->address().to_v6().to_bytes();
+    std::copy(group.begin(), group.end(), subscription.group);
+    shard.socket.send_to(std::array{const_buffer(&header, sizeof(header)), const_buffer(&subscription, sizeof(subscription))}, *info->dst());
+
+    if(!opened)
+        return;
+
+    auto& sender = *m_Shards.front();
+    auto timer = std::make_shared<steady_timer>(sender.context, MULTICAST_DELAY);
+    timer->async_wait([this, &sender, timer, round](const error_code& error)
     {
-        return {ind[i], ++i == ind.size()};
+        if(m_Log->log(error))
+            return;
+
+        {
+            std::lock_guard _(m_RoundsLock);
+            m_Rounds.erase(round->storage().get());
+        }
+
+        // the group gets End too, every subscriber asks for its own lost pages;
+        // stages of the round are recorded for the request which opened it
+        m_Stats.add(Counter::PagesSent, round->datagrams());
+        submit(sender, round->dst(), round,
+        [i = 0u, end = round->datagrams()]() mutable -> Index
+        { return {i, ++i == end}; }, round->accepted());
     });
 }
 
-void Server::resubmitLost(std::shared_ptr<udp::endpoint> dst, uint32_t recvd)
+// bitmap has a bit per page from header.index on, set for received ones; work is linear in its words
+// and missing pages, pages past it are not asked for
+void Server::resubmitLost(Shard& shard, std::shared_ptr<udp::endpoint> dst, const Header& header, uint32_t recvd)
 {
-    std::vector<uint16_t> idx;
-    idx.resize((recvd - 1/*padding*/) / 2);
-    memcpy(idx.data(), m_Buffer, recvd - 1/*padding*/);
+    auto info = m_Sessions.find(*dst);
 
-    std::shared_lock _(m_submitQMtx);
-
-    if(m_submitQueue.empty())
+    if(!info || info->session() != header.session)
     {
-        m_Log->log("submit queue empty");
+        m_Log->log("unknown session", Level::Warning);
         return;
     }
 
-    const auto& info = *std::find_if(m_submitQueue.begin(), m_submitQueue.end(),
-        [=](const auto& val) { return val->dst() == dst; });
+    const uint32_t words = recvd / sizeof(uint64_t);
+    const uint64_t end = std::min<uint64_t>((uint64_t)header.index + std::min<uint64_t>(header.pages, words * 64ull), info->pages().size());
+    const std::byte* bitmap = shard.buffer + sizeof(Header);
+
+    std::vector<uint32_t> idx;
+    for(uint32_t word = 0; word < words; ++word)
+    {
+        uint64_t received;
+        memcpy(&received, bitmap + word * sizeof(received), sizeof(received));
+
+        for(uint64_t missing = ~received; missing; missing &= missing - 1)
+        {
+            uint64_t index = header.index + word * 64ull + std::countr_zero(missing);
+            if(index >= end)
+                break;
+            idx.push_back(index);
+        }
+    }
+
+    m_Stats.add(Counter::Nacks);
+    if(idx.empty())
+        return;
+
+    m_Stats.add(Counter::PagesResent, idx.size());
+    shard.transmitter.congested(*dst, idx.size());
 
-    submit(std::move(dst), info->pages(), [i = 0u, ind = idx]() mutable -> Index 
+    // pages of a subscriber were lost from the group, which slows down for the worst of its receivers
+    if(info->subscriber())
+    {
+        auto& sender = *m_Shards.front();
+        boost::asio::post(sender.context, [this, &sender, lost = (uint32_t)idx.size(), sent = info->datagrams()]()
+        {
+            sender.transmitter.congested(*m_Multicast, lost, sent);
+        });
+    }
+
+    submit(shard, std::move(dst), info, [i = 0u, ind = std::move(idx)]() mutable -> Index 
     {
         return {ind[i], ++i == ind.size()};
     });
 }
 
-void Server::forget(std::shared_ptr<udp::endpoint> dst)
+void Server::forget(Shard& shard, std::shared_ptr<udp::endpoint> dst, uint32_t session)
 {
-    std::unique_lock _(m_submitQMtx);
-    if(!m_submitQueue.empty())
-        auto iter = std::remove_if(m_submitQueue.begin(), m_submitQueue.end(),
-            [=](const auto& val) { return val->dst() == dst; });
+    // ack of earlier session from the same endpoint must not drop the current one
+    auto info = m_Sessions.find(*dst);
+    if(!info || info->session() != session)
+        return;
+
+    m_Stats.add(Counter::Acks);
+    m_Stats.record(Stage::Acked, info->accepted());
+    shard.transmitter.release(*dst);
+    m_Sessions.erase(*dst);
 }
+
+void Server::expire(Shard& shard)
+{
+    shard.expiry.expires_after(SESSION_TIMEOUT / 2);
+    shard.expiry.async_wait([this, &shard](const error_code& error)
+    {
+        m_Log->log(error);
+        if(uint32_t expired = m_Sessions.expire())
+        {
+            m_Stats.add(Counter::Expired, expired);
+            m_Log->log(std::to_string(expired) + " sessions expired");
+        }
+        expire(shard);
+    });
+}
+
+std::string Server::stats()
+{
+    return m_Stats.json({
+        {"waiting", m_Generator.waiting()},
+        {"sessions", m_Sessions.size()},
+        {"cached", m_Cache.size()},
+        {"mappedMiB", m_Pool.mapped() >> 20},
+    });
+}
+
+// answered by anyone asking, header tells the session of the asking side back
+void Server::reportStats(Shard& shard, const udp::endpoint& dst, uint32_t session)
+{
+    Header header{.type = Message::Stats, .session = session};
+    std::string text = stats();
+    text.resize(std::min<std::size_t>(text.size(), sizeof(shard.buffer) - sizeof(header)));
+    shard.socket.send_to(std::array{const_buffer(&header, sizeof(header)), const_buffer(text.data(), text.size())}, dst);
+}
+
+void Server::dumpStats(Shard& shard)
+{
+    auto timer = std::make_shared<steady_timer>(shard.context, std::chrono::seconds(m_Settings.statsInterval));
+    timer->async_wait([this, &shard, timer](const error_code& error)
+    {
+        if(m_Log->log(error))
+            return;
+        m_Log->log(stats());
+        dumpStats(shard);
+    });
+}
\ No newline at end of file
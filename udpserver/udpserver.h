@@ -5,14 +5,22 @@
 #include <boost/asio/buffer.hpp>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ip/udp.hpp>
-#include <boost/asio/strand.hpp>
 #include <cstdint>
 #include <memory>
-#include <shared_mutex>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <thread>
+#include <unordered_map>
 #include "../common/logger.h"
+#include "config.h"
+#include "datasetcache.h"
 #include "generator.h"
+#include "sessiontable.h"
+#include "stats.h"
+#include "storagepool.h"
 #include "submitinfo.h"
+#include "transmitter.h"
 
 using boost::asio::ip::udp;
 using boost::asio::const_buffer;
@@ -20,39 +28,61 @@ using boost::system::error_code;
 using boost::asio::steady_timer;
 
 struct Index;
+struct Shard;
+struct Completion;
 
 class Server
 {
-    boost::asio::io_context m_Context;
-    std::jthread            m_InOutThread;
+    Settings                m_Settings;
     uint16_t                m_Port;
-    udp::socket             m_Socket;
-
-    boost::asio::io_context::strand m_Strand;
 
     std::shared_ptr<Logger>     m_Log;
+    // recorded by network and generator threads without locking
+    Stats                       m_Stats;
+
+    SessionTable             m_Sessions;
+
+    // multicast group, nullptr when multicast is off; rounds not started yet are keyed by dataset,
+    // identical deterministic requests share it through the cache
+    std::shared_ptr<udp::endpoint>  m_Multicast;
+    std::mutex                      m_RoundsLock;
+    std::unordered_map<const void*, std::shared_ptr<const SubmitInfo>> m_Rounds;
 
-    SubmitQueue              m_submitQueue;
-    std::shared_mutex        m_submitQMtx;
+    // every shard owns socket bound to m_Port (SO_REUSEPORT), io_context and thread
+    std::vector<std::unique_ptr<Shard>> m_Shards;
 
+    // recycled datasets, must outlive generator
+    StoragePool             m_Pool;
+    // finished deterministic datasets, its callbacks are run by generator
+    DatasetCache            m_Cache;
+    // destroyed first, so no finished dataset is handed to a dead shard
     Generator               m_Generator;
-    
-    std::byte               m_Buffer[65515/*max possible udp packet*/];
 
     private:
-        bool validate(std::shared_ptr<udp::endpoint> endpoint, double seed);
-        void receive();
-        void submit(std::shared_ptr<udp::endpoint> dst, const std::vector<const_buffer>& pages, std::function<Index()> nextIdx);
-        void submit(std::shared_ptr<udp::endpoint> dst, const std::vector<std::byte>& checksums);
+        bool validate(Shard& shard, std::shared_ptr<udp::endpoint> endpoint, uint32_t session, double seed);
+        void refuse(Shard& shard, const udp::endpoint& endpoint, uint32_t session, std::string msg);
+        void receive(Shard& shard);
+        // false when the pool has no room even after the cache gave up its datasets
+        bool generate(double seed, SubmitCallback ready, bool sorted, std::optional<uint64_t> key = std::nullopt);
+        // with accepted, the first page and End record their stages once handed to the kernel
+        void submit(Shard& shard, std::shared_ptr<udp::endpoint> dst, std::shared_ptr<const SubmitInfo> info, std::function<Index()> nextIdx,
+            std::optional<Timestamp> accepted = std::nullopt);
 
         // helpers
-        void processNewConnection(std::shared_ptr<udp::endpoint> dst);
-        void resubmitChecksums(std::shared_ptr<udp::endpoint> dst, uint32_t recvd);
-        void resubmitLost(std::shared_ptr<udp::endpoint> dst, uint32_t recvd);
-        void forget(std::shared_ptr<udp::endpoint> dst);
+        // recvd counts bytes after header
+        void processNewConnection(Shard& shard, std::shared_ptr<udp::endpoint> dst, uint32_t session, uint32_t recvd);
+        void publish(Shard& shard, Completion completion);
+        void subscribe(Shard& shard, Completion completion, Codec codec);
+        void resubmitLost(Shard& shard, std::shared_ptr<udp::endpoint> dst, const Header& header, uint32_t recvd);
+        void forget(Shard& shard, std::shared_ptr<udp::endpoint> dst, uint32_t session);
+        void expire(Shard& shard);
+        void reportStats(Shard& shard, const udp::endpoint& dst, uint32_t session);
+        void dumpStats(Shard& shard);
+        std::string stats();
 
     public:
-        Server(uint16_t port);
+        Server(const Settings& settings);
+        ~Server();
         void runLoop();
 };
 